@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "GraphicPrimitives/FigureValue.h"
+
+/*!
+\brief Общие средства программ замера производительности
+
+Размеры замеров задаются аргументами командной строки, время берется лучшее из нескольких повторов,
+сцены строятся генератором случайных чисел с фиксированным начальным значением и одинаковы между запусками
+*/
+namespace Benchmark {
+
+using Clock = std::chrono::steady_clock;
+
+/*!
+Возвращает время в миллисекундах, прошедшее с момента <i>start</i>
+\param start момент начала замера
+\return <i>double</i>
+*/
+inline double elapsed(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/*!
+Возвращает наименьшее время выполнения функции из нескольких повторов в миллисекундах
+\param repeats количество повторов
+\param function замеряемая функция
+\return <i>double</i>
+*/
+template<typename Function>
+double bestOf(size_t repeats, Function function) {
+    double best = 0;
+    for(size_t i = 0; i < repeats; i++) {
+        Clock::time_point start = Clock::now();
+        function();
+        double time = elapsed(start);
+        best = i == 0 ? time : std::min(best, time);
+    }
+    return best;
+}
+
+/*!
+Возвращает числовой аргумент командной строки или значение по умолчанию, если аргумент не задан
+\param argc количество аргументов
+\param argv аргументы
+\param index номер аргумента
+\param fallback значение по умолчанию
+\return <i>size_t</i>
+*/
+inline size_t argument(int argc, char* argv[], int index, size_t fallback) {
+    return index < argc ? size_t(std::strtoull(argv[index], nullptr, 10)) : fallback;
+}
+
+/*!
+Строит сцену из графических примитивов всех типов вперемешку, размеры фигур от 1 до <i>maxSize</i>
+\param count количество графических примитивов
+\param width ширина сцены
+\param height высота сцены
+\param maxSize наибольший размер фигуры
+\param seed начальное значение генератора
+\return <i>std::vector<GraphicPrimitive::FigureValue></i>
+*/
+inline std::vector<GraphicPrimitive::FigureValue> randomScene(size_t count, double width, double height, double maxSize, unsigned seed = 1) {
+    using namespace GraphicPrimitive;
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> x(0, width);
+    std::uniform_real_distribution<double> y(0, height);
+    std::uniform_real_distribution<double> size(1, maxSize);
+    std::vector<FigureValue> figures;
+    figures.reserve(count);
+    for(size_t i = 0; i < count; i++) {
+        Point corner = {x(random), y(random)};
+        uint32_t penColor = 0xFF000000u | uint32_t(random());
+        uint32_t brushColor = 0xFF000000u | uint32_t(random());
+        BrushType brushType = i % 4 == 0 ? BrushType::None : BrushType::Solid;
+        switch(i % 5) {
+        case 0:
+            figures.push_back(Line(corner, {corner.x + size(random) - maxSize / 2, corner.y + size(random) - maxSize / 2}, penColor, PenType::Solid, 1));
+            break;
+        case 1:
+            figures.push_back(Rectangle(corner, size(random), size(random), penColor, PenType::Solid, 1, brushColor, brushType));
+            break;
+        case 2:
+            figures.push_back(Circle(corner, size(random) / 2, penColor, PenType::Solid, 1, brushColor, brushType));
+            break;
+        case 3:
+            figures.push_back(Square(corner, size(random), penColor, PenType::Solid, 1, brushColor, brushType));
+            break;
+        default:
+            figures.push_back(Ellipse(corner, size(random) / 2, size(random) / 2, penColor, PenType::Solid, 1, brushColor, brushType));
+            break;
+        }
+    }
+    return figures;
+}
+
+}
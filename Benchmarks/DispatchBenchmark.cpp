@@ -0,0 +1,69 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "GUI/Painter.h"
+
+/*!
+Замер стоимости выбора перегрузки для графического примитива. Сравнивается прежний путь представления -
+переключатель по виртуальному <i>type()</i> и <i>dynamic_cast</i> к типу примитива - со статическим выбором
+через <i>std::visit</i> по <i>FigureValue</i>. Для каждого примитива вычисляется <i>figureBounds</i>, чтобы
+растеризация не заслоняла стоимость выбора.
+Аргументы: количество примитивов (по умолчанию 1000000), количество повторов (по умолчанию 5)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+
+GUI::Area boundsByCast(const Figure& figure) {
+    switch(figure.type()) {
+    case FigureType::Line:
+        return GUI::figureBounds(*dynamic_cast<const Line*>(&figure));
+    case FigureType::Rectangle:
+        return GUI::figureBounds(*dynamic_cast<const Rectangle*>(&figure));
+    case FigureType::Circle:
+        return GUI::figureBounds(*dynamic_cast<const Circle*>(&figure));
+    case FigureType::Square:
+        return GUI::figureBounds(*dynamic_cast<const Square*>(&figure));
+    case FigureType::Ellipse:
+        return GUI::figureBounds(*dynamic_cast<const Ellipse*>(&figure));
+    default:
+        return {};
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = Benchmark::argument(argc, argv, 1, 1000000);
+    size_t repeats = Benchmark::argument(argc, argv, 2, 5);
+
+    std::vector<FigureValue> values = Benchmark::randomScene(count, 10000, 10000, 100);
+    std::vector<std::shared_ptr<Figure>> pointers;
+    pointers.reserve(values.size());
+    for(const auto& value : values) {
+        pointers.push_back(std::visit([](const auto& figure) -> std::shared_ptr<Figure> {
+            return std::make_shared<std::decay_t<decltype(figure)>>(figure);
+        }, value));
+    }
+
+    volatile double sink = 0;
+    double castTime = Benchmark::bestOf(repeats, [&pointers, &sink] {
+        double sum = 0;
+        for(const auto& figure : pointers) {
+            sum += boundsByCast(*figure).width;
+        }
+        sink = sum;
+    });
+    double visitTime = Benchmark::bestOf(repeats, [&values, &sink] {
+        double sum = 0;
+        for(const auto& figure : values) {
+            sum += GUI::figureBounds(figure).width;
+        }
+        sink = sum;
+    });
+
+    std::printf("%zu figures, figureBounds dispatch\n", count);
+    std::printf("switch + dynamic_cast  %7.2f ns/figure\n", castTime * 1e6 / double(count));
+    std::printf("std::visit             %7.2f ns/figure\n", visitTime * 1e6 / double(count));
+    return 0;
+}
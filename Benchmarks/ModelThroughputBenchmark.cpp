@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <thread>
+#include <atomic>
+
+#include "Benchmark.h"
+#include "GraphicPrimitivesModel/GraphicPrimitivesModel.h"
+
+/*!
+Замер пропускной способности модели с одним писателем и несколькими читателями. Писатель удаляет случайный графический
+примитив и добавляет новый в конец, читатели берут снимок и читают из него окно подряд идущих примитивов, считая прочитанные действительные примитивы.
+Количество читателей удваивается от нуля до заданного, для каждого выводятся операции писателя, снимки и прочитанные
+примитивы в секунду.
+Аргументы: количество примитивов (по умолчанию 100000), длительность замера в мс (по умолчанию 1000),
+наибольшее количество читателей (по умолчанию 4)
+*/
+namespace {
+
+constexpr size_t ReadWindow = 1000; ///< примитивов, читаемых из одного снимка
+
+}
+
+int main(int argc, char* argv[]) {
+    using namespace GraphicPrimitive;
+
+    size_t count = Benchmark::argument(argc, argv, 1, 100000);
+    size_t duration = Benchmark::argument(argc, argv, 2, 1000);
+    size_t maxReaders = Benchmark::argument(argc, argv, 3, 4);
+
+    std::vector<FigureValue> scene = Benchmark::randomScene(count, 10000, 10000, 100);
+    std::printf("%zu figures, %zu ms per run\n", count, duration);
+    std::printf("readers  writer ops/s  snapshots/s  figure reads/s\n");
+    for(size_t readerCount = 0; readerCount <= maxReaders; readerCount = readerCount == 0 ? 1 : readerCount * 2) {
+        Model::GraphicPrimitivesModel model;
+        model.addFigures(scene);
+
+        std::atomic<bool> running = true;
+        std::atomic<size_t> snapshots = 0;
+        std::atomic<size_t> reads = 0;
+        std::vector<std::thread> readers;
+        for(size_t i = 0; i < readerCount; i++) {
+            readers.emplace_back([&model, &running, &snapshots, &reads, i]() {
+                std::mt19937 random(unsigned(i + 1));
+                size_t localSnapshots = 0;
+                size_t localReads = 0;
+                while(running) {
+                    auto snapshot = model.snapshot();
+                    size_t first = random() % snapshot.count();
+                    size_t last = std::min(first + ReadWindow, snapshot.count());
+                    for(size_t j = first; j < last; j++) {
+                        localReads += asFigure(snapshot.figure(j)).type() != FigureType::None;
+                    }
+                    localSnapshots++;
+                }
+                snapshots += localSnapshots;
+                reads += localReads;
+            });
+        }
+
+        std::mt19937 random(0);
+        size_t operations = 0;
+        Benchmark::Clock::time_point start = Benchmark::Clock::now();
+        double time = 0;
+        while(time < double(duration)) {
+            model.removeFigure(random() % model.count());
+            model.addFigure(scene[operations % scene.size()]);
+            operations++;
+            time = Benchmark::elapsed(start);
+        }
+        running = false;
+        for(auto& reader : readers) {
+            reader.join();
+        }
+
+        double seconds = time / 1000;
+        std::printf("%7zu  %12.0f  %11.0f  %14.0f\n", readerCount, double(operations) / seconds,
+                    double(snapshots) / seconds, double(reads) / seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "GUI/Painter.h"
+
+/*!
+Замер отрисовки контуров без заливки на холсте 1920x1080: отрезки длиной около 110 пикселей, прямоугольники 120x80
+и эллипсы с полуосями от 40 до 90 кистями Solid, Dash и Dot шириной от 1 до 64. Выводится время на одну фигуру.
+Аргументы: количество фигур на замер (по умолчанию 3000), количество повторов (по умолчанию 3)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+
+constexpr uint32_t PenColor = 0xFF112233u;
+
+/// Вид замеряемой фигуры
+enum class Shape {
+    Line,
+    Rectangle,
+    Ellipse
+};
+
+/*!
+Строит набор одинаковых по виду фигур со случайным расположением, одинаковый для всех типов кисти
+\param shape вид фигуры
+\param count количество фигур
+\param penType тип кисти
+\param penWidth ширина кисти
+\return <i>std::vector<FigureValue></i>
+*/
+std::vector<FigureValue> strokes(Shape shape, size_t count, PenType penType, float penWidth) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> x(100, 1800);
+    std::uniform_real_distribution<double> y(100, 980);
+    std::uniform_real_distribution<double> offset(-80, 80);
+    std::uniform_real_distribution<double> radius(40, 90);
+    std::vector<FigureValue> figures;
+    figures.reserve(count);
+    for(size_t i = 0; i < count; i++) {
+        Point center = {x(random), y(random)};
+        switch(shape) {
+        case Shape::Line:
+            figures.push_back(Line(center, {center.x + offset(random), center.y + offset(random)}, PenColor, penType, penWidth));
+            break;
+        case Shape::Rectangle:
+            figures.push_back(Rectangle({center.x - 60, center.y - 40}, 120, 80, PenColor, penType, penWidth, 0, BrushType::None));
+            break;
+        case Shape::Ellipse:
+            figures.push_back(Ellipse(center, radius(random), radius(random) * 0.6, PenColor, penType, penWidth, 0, BrushType::None));
+            break;
+        }
+    }
+    return figures;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = Benchmark::argument(argc, argv, 1, 3000);
+    size_t repeats = Benchmark::argument(argc, argv, 2, 3);
+
+    GUI::Painter painter;
+    painter.setCanvas(std::make_shared<GUI::Canvas>(1920, 1080));
+
+    const char* names[] = {"line", "rect", "ellipse"};
+    std::printf("%zu figures per run, us per figure\n", count);
+    std::printf("width  shape      solid     dash      dot\n");
+    for(float penWidth : {1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f}) {
+        for(Shape shape : {Shape::Line, Shape::Rectangle, Shape::Ellipse}) {
+            double times[3];
+            size_t column = 0;
+            for(PenType penType : {PenType::Solid, PenType::Dash, PenType::Dot}) {
+                std::vector<FigureValue> figures = strokes(shape, count, penType, penWidth);
+                double time = Benchmark::bestOf(repeats, [&painter, &figures] {
+                    for(const auto& figure : figures) {
+                        painter.drawFigure(figure);
+                    }
+                });
+                times[column++] = time * 1000 / double(count);
+            }
+            std::printf("%5g  %-8s %7.2f  %7.2f  %7.2f\n", penWidth, names[size_t(shape)], times[0], times[1], times[2]);
+        }
+    }
+    return 0;
+}
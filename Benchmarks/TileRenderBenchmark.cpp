@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <thread>
+
+#include "Benchmark.h"
+#include "GUI/View.h"
+
+/*!
+Замер полной перерисовки холста 3840x2160: растеризация фигур по одной (<i>Sequential</i>) и по плиткам на планировщике
+с разным количеством рабочих потоков, от одного до количества ядер с удвоением. Проверяется, что результат по плиткам
+совпадает с последовательным попиксельно.
+Аргументы: количество примитивов (по умолчанию 500000), количество повторов (по умолчанию 3)
+*/
+int main(int argc, char* argv[]) {
+    constexpr uint32_t Width = 3840;
+    constexpr uint32_t Height = 2160;
+    size_t count = Benchmark::argument(argc, argv, 1, 500000);
+    size_t repeats = Benchmark::argument(argc, argv, 2, 3);
+
+    auto model = std::make_shared<Model::GraphicPrimitivesModel>();
+    model->addFigures(Benchmark::randomScene(count, Width, Height, 60));
+
+    GUI::View reference(Width, Height);
+    reference.setRenderMode(GUI::View::RenderMode::Sequential);
+    reference.setModel(model);
+    double sequential = Benchmark::bestOf(repeats, [&reference] {
+        reference.redraw();
+    });
+    std::printf("%zu figures on %ux%u\n", count, Width, Height);
+    std::printf("sequential           %8.1f ms\n", sequential);
+
+    size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    for(size_t threads = 1; ; threads = std::min(threads * 2, cores)) {
+        Scheduler::JobScheduler scheduler(threads);
+        GUI::View view(Width, Height);
+        view.setScheduler(&scheduler);
+        view.setModel(model);
+        double tiled = Benchmark::bestOf(repeats, [&view] {
+            view.redraw();
+        });
+
+        const uint32_t* pixels = view.canvas()->scanline(0);
+        bool equal = std::equal(pixels, pixels + size_t(Width) * Height, reference.canvas()->scanline(0));
+        std::printf("tiled, %2zu threads    %8.1f ms  speedup %5.2f  %s\n", threads, tiled, sequential / tiled, equal ? "identical" : "MISMATCH");
+        if(threads == cores) {
+            break;
+        }
+    }
+    return 0;
+}
@@ -18,18 +18,22 @@ namespace Controler {
 Класс, который позволяют добавлять, удалять объекты модели, актуальность данных модели осуществляют через callback-и
 */
 class Controler {
-    std::list<GraphicPrimitive::FigureType> m_createdFigures;
+    std::pmr::vector<GraphicPrimitive::FigureType> m_createdFigures;
     std::shared_ptr<Model::GraphicPrimitivesModel> m_model;
     size_t m_addConnectedIndex;
     size_t m_removedConnectedIndex;
 
 public:
-    Controler() {
+    explicit Controler(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : m_createdFigures(resource) {
 
     }
 
+    ~Controler() {
+        resetModel();
+    }
+
 /*!
-Связывает объект с моделью, подключает callback-и
+Связывает объект с моделью, подключает callback-и. Callback-и прежней модели отключаются
 \param model модель
 \return <i>void</i>
 */
@@ -38,13 +42,12 @@ public:
             return;
         }
 
+        resetModel();
         m_model = model;
-        m_addConnectedIndex = m_model->connectToAddFigure([this](size_t index){ addFigure(index); });
-        m_removedConnectedIndex = m_model->connectToRemoveFigure([this](size_t index){ removeFigure(index); });
+        m_addConnectedIndex = m_model->connectToAddFigures([this](size_t first, size_t count){ addFigures(first, count); });
+        m_removedConnectedIndex = m_model->connectToRemoveFigures([this](size_t first, size_t count){ removeFigures(first, count); });
 
-        for(size_t i = 0; i < m_model->count(); i++) {
-            addFigure(i);
-        }
+        addFigures(0, m_model->count());
     }
 
  /*!
@@ -149,29 +152,32 @@ public:
 
 private:
  /*!
-Callback на добавление графического примитива в модель
-\param index индекс добавленного графичекого примитива
+Callback на добавление диапазона графических примитивов в модель. Типы хранятся для всех индексов модели, чтобы индексы совпадали
+\param first индекс первого добавленного графичекого примитива
+\param count количество добавленных графических примитивов
 \return <i>void</i>
 */
-    void addFigure(size_t index) {
-        auto figure = m_model->data(index);
-
-        switch (figure->type()) {
-        case GraphicPrimitive::FigureType::None:
-            break;
-        default:
-            m_createdFigures.push_back(figure->type());
+    void addFigures(size_t first, size_t count) {
+        std::vector<GraphicPrimitive::FigureType> types(count);
+        for(size_t i = 0; i < count; i++) {
+            types[i] = GraphicPrimitive::asFigure(m_model->figure(first + i)).type();
         }
+        m_createdFigures.insert(std::next(m_createdFigures.begin(), first), types.begin(), types.end());
     }
 
  /*!
-Callback на удаление графического примитива из модели
-\param index индекс удаляемого графичекого примитива из модели
+Callback на удаление диапазона графических примитивов из модели
+\param first индекс первого удаляемого графичекого примитива из модели
+\param count количество удаляемых графических примитивов
 \return <i>void</i>
 */
-    void removeFigure(size_t index) {
-        auto removedFigureItr = std::next(m_createdFigures.begin(), index);
-        m_createdFigures.erase(removedFigureItr);
+    void removeFigures(size_t first, size_t count) {
+        if(first >= m_createdFigures.size()) {
+            return;
+        }
+
+        auto removedBegin = std::next(m_createdFigures.begin(), first);
+        m_createdFigures.erase(removedBegin, std::next(removedBegin, std::min(count, m_createdFigures.size() - first)));
     }
 };
 
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include "View.h"
+#include "Scheduler/SpscQueue.h"
+
+namespace GUI {
+
+/*!
+\brief Статистика кадров асинхронного представления
+*/
+struct FrameStatistics {
+    size_t frames = 0;           ///< опубликовано кадров
+    size_t droppedFrames = 0;    ///< пропущено интервалов кадра из-за долгой отрисовки
+    double lastFrameTime = 0;    ///< время подготовки последнего кадра, мс
+    double averageFrameTime = 0; ///< среднее время подготовки кадра, мс
+    double maxFrameTime = 0;     ///< наибольшее время подготовки кадра, мс
+};
+
+/*!
+\brief Графическое представление с отдельным потоком отрисовки
+
+Callback-и модели выполняются в потоке редактирования и только помещают в очередь без блокировок одно изменение на вызов:
+диапазон передается вместе со снимком версии модели после изменения, поэтому время правки не зависит ни от стоимости перерисовки,
+ни от количества затронутых примитивов. Поток отрисовки раз в интервал кадра забирает накопленные изменения и передает их диапазоны
+представлению в режиме отложенной перерисовки, которое связано со снимком: области изменений берутся из диапазонов, а графические
+примитивы читаются из последнего снимка, копия модели не хранится. Затем перерисовывается объединенная область изменений.
+
+Готовый кадр копируется в задний буфер и публикуется атомарной заменой переднего буфера. Читатель получает передний буфер
+через <i>frame()</i> и может держать его сколько угодно: если прежний передний буфер еще используется читателем, задним буфером
+становится его новая копия
+*/
+class AsyncView {
+    /// Изменение модели, передаваемое потоку отрисовки
+    struct RenderEvent {
+        enum class Type : uint8_t {
+            Add,   ///< добавление диапазона графических примитивов
+            Remove ///< удаление диапазона графических примитивов
+        };
+
+        Type type = Type::Add;
+        size_t first = 0;
+        size_t count = 0;
+        Model::GraphicPrimitivesModel::Snapshot snapshot; ///< версия модели после изменения
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t QueueCapacity = 64 * 1024; ///< емкость очереди изменений
+
+    View m_view;
+    std::shared_ptr<Canvas> m_front;
+    std::shared_ptr<Canvas> m_back;
+    Area m_previousFrameArea;
+
+    Scheduler::SpscQueue<RenderEvent> m_events;
+    std::atomic<size_t> m_pushedEvents = 0;
+    size_t m_renderedEvents = 0;
+    mutable std::mutex m_renderedMutex;
+    mutable std::condition_variable m_rendered;
+
+    mutable std::mutex m_statisticsMutex;
+    FrameStatistics m_statistics;
+    double m_totalFrameTime = 0;
+
+    std::shared_ptr<Model::GraphicPrimitivesModel> m_model;
+    size_t m_addConnectedIndex = 0;
+    size_t m_removedConnectedIndex = 0;
+
+    Clock::duration m_frameInterval;
+    std::atomic<bool> m_running = true;
+    std::thread m_thread;
+
+public:
+/*!
+Создает представление и запускает поток отрисовки
+\param width ширина холста
+\param height высота холста
+\param frameInterval интервал кадра
+\param scheduler планировщик, на котором поток отрисовки растеризует плитки
+*/
+    AsyncView(uint32_t width, uint32_t height, std::chrono::milliseconds frameInterval = std::chrono::milliseconds(16),
+              Scheduler::JobScheduler* scheduler = nullptr) :
+        m_view(width, height),
+        m_front(std::make_shared<Canvas>(width, height)),
+        m_back(std::make_shared<Canvas>(width, height)),
+        m_events(QueueCapacity),
+        m_frameInterval(frameInterval)
+    {
+        m_view.setScheduler(scheduler);
+        m_view.setRepaintMode(View::RepaintMode::Deferred);
+        m_view.setSnapshot({});
+        m_thread = std::thread([this]() { render(); });
+    }
+
+    AsyncView(const AsyncView&) = delete;
+    AsyncView& operator=(const AsyncView&) = delete;
+
+    ~AsyncView() {
+        resetModel();
+        m_running = false;
+        m_thread.join();
+    }
+
+ /*!
+Связывает объект с моделью, подключает callback-и. Графические примитивы модели передаются потоку отрисовки
+\param model модель
+\return <i>void</i>
+*/
+    void setModel(const std::shared_ptr<Model::GraphicPrimitivesModel>& model) {
+        if(!model) {
+            return;
+        }
+
+        resetModel();
+        m_model = model;
+        m_addConnectedIndex = m_model->connectToAddFigures([this](size_t first, size_t count) { figuresAdded(first, count); });
+        m_removedConnectedIndex = m_model->connectToRemoveFigures([this](size_t first, size_t count) { figuresRemoved(first, count); });
+
+        figuresAdded(0, m_model->count());
+    }
+
+ /*!
+Отвязывает объект от установленной модели, отключает callback-и. Графические примитивы модели убираются с кадра
+\return <i>void</i>
+*/
+    void resetModel() {
+        if(!m_model) {
+            return;
+        }
+
+        m_model->disconnectToAddFigure(m_addConnectedIndex);
+        m_model->disconnectToRemoveFigure(m_removedConnectedIndex);
+        push({RenderEvent::Type::Remove, 0, m_model->count(), {}});
+        m_model.reset();
+    }
+
+ /*!
+Возвращает последний опубликованный кадр. Кадр не изменяется, пока на него есть указатель
+\return <i>std::shared_ptr<const Canvas></i>
+*/
+    std::shared_ptr<const Canvas> frame() const {
+        return std::atomic_load(&m_front);
+    }
+
+ /*!
+Возвращает статистику кадров: время подготовки и количество пропущенных интервалов
+\return <i>FrameStatistics</i>
+*/
+    FrameStatistics frameStatistics() const {
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        return m_statistics;
+    }
+
+ /*!
+Дожидается, пока все переданные изменения будут отрисованы и опубликованы
+\return <i>void</i>
+*/
+    void waitForFrame() const {
+        size_t pushed = m_pushedEvents;
+        std::unique_lock<std::mutex> lock(m_renderedMutex);
+        m_rendered.wait(lock, [this, pushed]() { return m_renderedEvents >= pushed; });
+    }
+
+private:
+/*!
+Помещает изменение в очередь. Если очередь заполнена, производитель уступает процессор, пока поток отрисовки ее не освободит.
+Изменение занимает одно место в очереди на вызов callback-а, независимо от размера диапазона
+\param event изменение
+\return <i>void</i>
+*/
+    void push(RenderEvent&& event) {
+        while(!m_events.tryPush(std::move(event))) {
+            std::this_thread::yield();
+        }
+        m_pushedEvents++;
+    }
+
+/*!
+Передает потоку отрисовки добавленный диапазон вместе со снимком рабочей версии модели
+\param first индекс первого добавленного графического примитива
+\param count количество добавленных графических примитивов
+\return <i>void</i>
+*/
+    void figuresAdded(size_t first, size_t count) {
+        if(count > 0) {
+            push({RenderEvent::Type::Add, first, count, m_model->currentSnapshot()});
+        }
+    }
+
+/*!
+Передает потоку отрисовки удаленный диапазон вместе со снимком рабочей версии модели
+\param first индекс первого удаленного графического примитива
+\param count количество удаленных графических примитивов
+\return <i>void</i>
+*/
+    void figuresRemoved(size_t first, size_t count) {
+        if(count > 0) {
+            push({RenderEvent::Type::Remove, first, count, m_model->currentSnapshot()});
+        }
+    }
+
+/*!
+Тело потока отрисовки: раз в интервал кадра применяет накопленные изменения и публикует кадр, если что-то изменилось
+\return <i>void</i>
+*/
+    void render() {
+        auto frameStart = Clock::now();
+        while(m_running) {
+            size_t applied = applyEvents();
+            if(applied > 0) {
+                publishFrame(frameStart);
+                {
+                    std::lock_guard<std::mutex> lock(m_renderedMutex);
+                    m_renderedEvents += applied;
+                }
+                m_rendered.notify_all();
+            }
+
+            auto next = frameStart + m_frameInterval;
+            auto now = Clock::now();
+            if(now < next) {
+                std::this_thread::sleep_until(next);
+                frameStart = next;
+            }
+            else {
+                frameStart = now;
+            }
+        }
+    }
+
+/*!
+Передает представлению изменения, накопленные к началу кадра. Подряд идущие добавления смежных диапазонов объединяются
+в один диапазон с последним снимком, который содержит их все
+\return <i>size_t</i> количество примененных изменений
+*/
+    size_t applyEvents() {
+        size_t available = m_events.size();
+        RenderEvent added;
+        RenderEvent event;
+        for(size_t i = 0; i < available && m_events.tryPop(event); i++) {
+            if(event.type == RenderEvent::Type::Add && added.count > 0 && added.first + added.count == event.first) {
+                added.count += event.count;
+                added.snapshot = std::move(event.snapshot);
+                continue;
+            }
+
+            applyEvent(added);
+            added = {};
+            if(event.type == RenderEvent::Type::Add) {
+                added = std::move(event);
+            }
+            else {
+                applyEvent(event);
+            }
+            event = {};
+        }
+        applyEvent(added);
+        return available;
+    }
+
+/*!
+Передает представлению одно изменение
+\param event изменение
+\return <i>void</i>
+*/
+    void applyEvent(RenderEvent& event) {
+        if(event.count == 0) {
+            return;
+        }
+
+        if(event.type == RenderEvent::Type::Add) {
+            m_view.addFigures(std::move(event.snapshot), event.first, event.count);
+        }
+        else {
+            m_view.removeFigures(std::move(event.snapshot), event.first, event.count);
+        }
+    }
+
+/*!
+Перерисовывает накопленную область, копирует изменения двух последних кадров в задний буфер и публикует его
+\param frameStart начало кадра
+\return <i>void</i>
+*/
+    void publishFrame(Clock::time_point frameStart) {
+        Area frameArea = m_view.flush();
+        copyArea(*m_view.canvas(), *m_back, frameArea.united(m_previousFrameArea));
+        m_previousFrameArea = frameArea;
+
+        auto previousFront = std::atomic_exchange(&m_front, m_back);
+        if(previousFront.use_count() > 1) {
+            m_back = std::make_shared<Canvas>(*m_front);
+            m_previousFrameArea = {};
+        }
+        else {
+            m_back = std::move(previousFront);
+        }
+
+        double frameTime = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        double interval = std::chrono::duration<double, std::milli>(m_frameInterval).count();
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_statistics.frames++;
+        m_statistics.droppedFrames += size_t(frameTime / interval);
+        m_statistics.lastFrameTime = frameTime;
+        m_statistics.maxFrameTime = std::max(m_statistics.maxFrameTime, frameTime);
+        m_totalFrameTime += frameTime;
+        m_statistics.averageFrameTime = m_totalFrameTime / double(m_statistics.frames);
+    }
+
+/*!
+Копирует область одного холста в другой холст того же размера
+\param source исходный холст
+\param target холст назначения
+\param area область
+\return <i>void</i>
+*/
+    static void copyArea(const Canvas& source, Canvas& target, const Area& area) {
+        Area region = area.aligned().intersected(source.area());
+        if(region.isEmpty()) {
+            return;
+        }
+
+        auto x = size_t(region.corner.x);
+        auto width = size_t(region.width) * sizeof(uint32_t);
+        for(auto y = uint32_t(region.corner.y); y < uint32_t(region.bottom()); y++) {
+            std::memcpy(target.scanline(y) + x, source.scanline(y) + x, width);
+        }
+    }
+};
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+
+#include "Painter.h"
+
+namespace GUI {
+
+/*!
+\brief Область, ожидающая перерисовки
+
+Набор прямоугольников. Новый прямоугольник сливается с уже накопленным, если перерисовать их объединение дешевле,
+чем оба по отдельности: стоимость прямоугольника равна его площади плюс постоянная надбавка за отдельный проход перерисовки. Поэтому перекрывающиеся и соседние прямоугольники объединяются, а далекие остаются раздельными.
+Количество прямоугольников ограничено, при превышении сливается пара с наименьшей добавочной площадью
+*/
+class DirtyRegion {
+    static constexpr double RectOverhead = 64 * 64; ///< надбавка за отдельный прямоугольник, в пикселях площади
+    static constexpr size_t MaxRects = 32;          ///< наибольшее количество прямоугольников
+
+    std::vector<Area> m_rects;
+
+public:
+    DirtyRegion() {
+
+    }
+
+/*!
+Возвращает <i>true</i>, если перерисовывать нечего
+\return <i>bool</i>
+*/
+    bool isEmpty() const {
+        return m_rects.empty();
+    }
+
+/*!
+Возвращает прямоугольники области
+\return <i>const std::vector<Area>&</i>
+*/
+    const std::vector<Area>& rects() const {
+        return m_rects;
+    }
+
+/*!
+Возвращает наименьшую область, содержащую все прямоугольники
+\return <i>Area</i>
+*/
+    Area bounds() const {
+        Area result;
+        for(const auto& rect : m_rects) {
+            result = result.united(rect);
+        }
+        return result;
+    }
+
+/*!
+Добавляет область, которую нужно перерисовать, и сливает ее с накопленными прямоугольниками
+\param area область
+\return <i>void</i>
+*/
+    void add(const Area& area) {
+        if(area.isEmpty()) {
+            return;
+        }
+
+        Area merged = area.aligned();
+        for(size_t i = 0; i < m_rects.size(); ) {
+            if(mergeCost(merged, m_rects[i]) <= 0) {
+                merged = merged.united(m_rects[i]);
+                m_rects[i] = m_rects.back();
+                m_rects.pop_back();
+                i = 0;
+                continue;
+            }
+            i++;
+        }
+        m_rects.push_back(merged);
+
+        if(m_rects.size() > MaxRects) {
+            mergeCheapestPair();
+        }
+    }
+
+/*!
+Очищает область
+\return <i>void</i>
+*/
+    void clear() {
+        m_rects.clear();
+    }
+
+private:
+    static double cost(const Area& area) {
+        return area.width * area.height + RectOverhead;
+    }
+
+/*!
+Возвращает, насколько перерисовка объединения дороже перерисовки двух прямоугольников по отдельности.
+Неположительное значение означает, что прямоугольники выгодно слить
+\param first первый прямоугольник
+\param second второй прямоугольник
+\return <i>double</i>
+*/
+    static double mergeCost(const Area& first, const Area& second) {
+        Area overlap = first.intersected(second);
+        double separate = cost(first) + cost(second) - overlap.width * overlap.height;
+        return cost(first.united(second)) - separate;
+    }
+
+/*!
+Сливает пару прямоугольников с наименьшей добавочной стоимостью
+\return <i>void</i>
+*/
+    void mergeCheapestPair() {
+        size_t bestFirst = 0;
+        size_t bestSecond = 1;
+        double bestCost = mergeCost(m_rects[0], m_rects[1]);
+        for(size_t i = 0; i < m_rects.size(); i++) {
+            for(size_t j = i + 1; j < m_rects.size(); j++) {
+                double pairCost = mergeCost(m_rects[i], m_rects[j]);
+                if(pairCost < bestCost) {
+                    bestCost = pairCost;
+                    bestFirst = i;
+                    bestSecond = j;
+                }
+            }
+        }
+
+        Area merged = m_rects[bestFirst].united(m_rects[bestSecond]);
+        m_rects[bestSecond] = m_rects.back();
+        m_rects.pop_back();
+        m_rects[bestFirst] = merged;
+    }
+};
+
+}
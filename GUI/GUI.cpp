@@ -1,2 +1,6 @@
+#include "Stroke.h"
 #include "Painter.h"
+#include "DirtyRegion.h"
+#include "HitTest.h"
 #include "View.h"
+#include "AsyncView.h"
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include "Painter.h"
+
+/*!
+\brief Точная геометрия попадания в графические примитивы
+
+Проверки выполняются по геометрии примитива с учетом толщины кисти: расстояние до отрезка для отрезков,
+расстояние до границы для прямоугольников, уравнение эллипса и расстояние до его контура для окружностей и эллипсов.
+Без заливки внутренность фигуры в попадание не входит, попадает только контур. Фигура без кисти с нулевой шириной или высотой
+не занимает места на холсте и не попадает никуда, как и в <i>intersectsArea</i> и в пространственном индексе
+*/
+namespace GUI {
+
+/*!
+Возвращает половину толщины контура фигуры, 0 если контур не рисуется
+\param figure графический примитив
+\return <i>double</i>
+*/
+inline double outlineHalfWidth(const GraphicPrimitive::Figure& figure) {
+    return figure.penType() == GraphicPrimitive::PenType::None ? 0 : std::max(figure.penWidth(), 1.0f) / 2;
+}
+
+/*!
+Возвращает расстояние от точки до отрезка
+\param point точка
+\param first начало отрезка
+\param second конец отрезка
+\return <i>double</i>
+*/
+inline double distanceToSegment(const GraphicPrimitive::Point& point, const GraphicPrimitive::Point& first, const GraphicPrimitive::Point& second) {
+    double dx = second.x - first.x;
+    double dy = second.y - first.y;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = lengthSquared > 0 ? std::clamp(((point.x - first.x) * dx + (point.y - first.y) * dy) / lengthSquared, 0.0, 1.0) : 0.0;
+    return std::hypot(point.x - (first.x + t * dx), point.y - (first.y + t * dy));
+}
+
+/*!
+Возвращает расстояние от точки до области, 0 для точки внутри области
+\param point точка
+\param area область
+\return <i>double</i>
+*/
+inline double distanceToArea(const GraphicPrimitive::Point& point, const Area& area) {
+    double dx = std::max({area.corner.x - point.x, 0.0, point.x - area.right()});
+    double dy = std::max({area.corner.y - point.y, 0.0, point.y - area.bottom()});
+    return std::hypot(dx, dy);
+}
+
+/*!
+Возвращает <i>true</i>, если отрезок проходит через область (отсечение Лианга-Барски)
+\param first начало отрезка
+\param second конец отрезка
+\param area область
+\return <i>bool</i>
+*/
+inline bool segmentCrossesArea(const GraphicPrimitive::Point& first, const GraphicPrimitive::Point& second, const Area& area) {
+    double dx = second.x - first.x;
+    double dy = second.y - first.y;
+    double t0 = 0;
+    double t1 = 1;
+    auto clip = [&t0, &t1](double p, double q) {
+        if(p == 0) {
+            return q >= 0;
+        }
+
+        double t = q / p;
+        if(p < 0) {
+            t0 = std::max(t0, t);
+        }
+        else {
+            t1 = std::min(t1, t);
+        }
+        return t0 <= t1;
+    };
+    return clip(-dx, first.x - area.corner.x) && clip(dx, area.right() - first.x) &&
+           clip(-dy, first.y - area.corner.y) && clip(dy, area.bottom() - first.y);
+}
+
+/*!
+Возвращает расстояние от точки до контура эллипса с центром в начале координат. Ближайшая точка контура
+уточняется пятью итерациями по центрам кривизны эллипса (без тригонометрии), погрешность меньше сотой пикселя
+\param x координата x точки относительно центра
+\param y координата y точки относительно центра
+\param radiusX радиус по оси x
+\param radiusY радиус по оси y
+\return <i>double</i>
+*/
+inline double distanceToEllipse(double x, double y, double radiusX, double radiusY) {
+    double px = std::abs(x);
+    double py = std::abs(y);
+    double tx = 0.70710678118654752;
+    double ty = 0.70710678118654752;
+    for(int iteration = 0; iteration < 5; iteration++) {
+        double ex = (radiusX * radiusX - radiusY * radiusY) * tx * tx * tx / radiusX;
+        double ey = (radiusY * radiusY - radiusX * radiusX) * ty * ty * ty / radiusY;
+        double r = std::hypot(radiusX * tx - ex, radiusY * ty - ey);
+        double q = std::hypot(px - ex, py - ey);
+        if(q == 0) {
+            break;
+        }
+
+        tx = std::clamp(((px - ex) * r / q + ex) / radiusX, 0.0, 1.0);
+        ty = std::clamp(((py - ey) * r / q + ey) / radiusY, 0.0, 1.0);
+        double t = std::hypot(tx, ty);
+        tx /= t;
+        ty /= t;
+    }
+    return std::hypot(px - radiusX * tx, py - radiusY * ty);
+}
+
+inline bool hitTest(const GraphicPrimitive::InvalidFigure&, const GraphicPrimitive::Point&, double) {
+    return false;
+}
+
+/*!
+Проверяет попадание точки в отрезок с учетом толщины кисти
+\param line отрезок
+\param point точка
+\param tolerance допуск в единицах сцены
+\return <i>bool</i>
+*/
+inline bool hitTest(const GraphicPrimitive::Line& line, const GraphicPrimitive::Point& point, double tolerance) {
+    return distanceToSegment(point, line.p1(), line.p2()) <= std::max(line.penWidth(), 1.0f) / 2 + tolerance;
+}
+
+/*!
+Проверяет попадание точки в прямоугольную фигуру: во внутренность при заливке, иначе в полосу контура.
+Прямоугольник без кисти с нулевой стороной не попадает
+\param figure прямоугольник или квадрат
+\param area прямоугольник фигуры без контура
+\param point точка
+\param tolerance допуск в единицах сцены
+\return <i>bool</i>
+*/
+inline bool hitTestBox(const GraphicPrimitive::Figure& figure, const Area& area, const GraphicPrimitive::Point& point, double tolerance) {
+    double half = outlineHalfWidth(figure);
+    if(half == 0 && area.isEmpty()) {
+        return false;
+    }
+
+    double reach = half + tolerance;
+    double outside = distanceToArea(point, area);
+    if(outside > 0 || figure.brushType() != GraphicPrimitive::BrushType::None) {
+        return outside <= reach;
+    }
+
+    double inside = std::min({point.x - area.corner.x, area.right() - point.x, point.y - area.corner.y, area.bottom() - point.y});
+    return inside <= reach;
+}
+
+inline bool hitTest(const GraphicPrimitive::Rectangle& rectangle, const GraphicPrimitive::Point& point, double tolerance) {
+    return hitTestBox(rectangle, {rectangle.corner(), rectangle.width(), rectangle.height()}, point, tolerance);
+}
+
+inline bool hitTest(const GraphicPrimitive::Square& square, const GraphicPrimitive::Point& point, double tolerance) {
+    return hitTestBox(square, {square.corner(), square.width(), square.width()}, point, tolerance);
+}
+
+/*!
+Проверяет попадание точки в эллиптическую фигуру по уравнению эллипса. Вырожденный эллипс проверяется как отрезок,
+без кисти он не попадает
+\param figure окружность или эллипс
+\param center центр
+\param radiusX радиус по оси x
+\param radiusY радиус по оси y
+\param point точка
+\param tolerance допуск в единицах сцены
+\return <i>bool</i>
+*/
+inline bool hitTestEllipse(const GraphicPrimitive::Figure& figure, const GraphicPrimitive::Point& center, double radiusX, double radiusY,
+                           const GraphicPrimitive::Point& point, double tolerance) {
+    double half = outlineHalfWidth(figure);
+    double reach = half + tolerance;
+    if(radiusX <= 0 || radiusY <= 0) {
+        if(half == 0) {
+            return false;
+        }
+
+        GraphicPrimitive::Point first = {center.x - std::max(radiusX, 0.0), center.y - std::max(radiusY, 0.0)};
+        GraphicPrimitive::Point second = {center.x + std::max(radiusX, 0.0), center.y + std::max(radiusY, 0.0)};
+        return distanceToSegment(point, first, second) <= reach;
+    }
+
+    double x = point.x - center.x;
+    double y = point.y - center.y;
+    if(figure.brushType() != GraphicPrimitive::BrushType::None && x * x / (radiusX * radiusX) + y * y / (radiusY * radiusY) <= 1) {
+        return true;
+    }
+    return distanceToEllipse(x, y, radiusX, radiusY) <= reach;
+}
+
+inline bool hitTest(const GraphicPrimitive::Circle& circle, const GraphicPrimitive::Point& point, double tolerance) {
+    return hitTestEllipse(circle, circle.center(), circle.radius(), circle.radius(), point, tolerance);
+}
+
+inline bool hitTest(const GraphicPrimitive::Ellipse& ellipse, const GraphicPrimitive::Point& point, double tolerance) {
+    return hitTestEllipse(ellipse, ellipse.center(), ellipse.radiusX(), ellipse.radiusY(), point, tolerance);
+}
+
+/*!
+Проверяет попадание точки в графический примитив, хранимый по значению
+\param figure графический примитив
+\param point точка
+\param tolerance допуск в единицах сцены
+\return <i>bool</i>
+*/
+inline bool hitTest(const GraphicPrimitive::FigureValue& figure, const GraphicPrimitive::Point& point, double tolerance) {
+    return std::visit([&point, tolerance](const auto& value) { return hitTest(value, point, tolerance); }, figure);
+}
+
+inline bool intersectsArea(const GraphicPrimitive::InvalidFigure&, const Area&) {
+    return false;
+}
+
+/*!
+Проверяет, задевает ли отрезок с учетом толщины кисти область
+\param line отрезок
+\param area область
+\return <i>bool</i>
+*/
+inline bool intersectsArea(const GraphicPrimitive::Line& line, const Area& area) {
+    if(segmentCrossesArea(line.p1(), line.p2(), area)) {
+        return true;
+    }
+
+    double half = std::max(line.penWidth(), 1.0f) / 2;
+    double distance = std::min(distanceToArea(line.p1(), area), distanceToArea(line.p2(), area));
+    for(auto corner : {area.corner, GraphicPrimitive::Point{area.right(), area.corner.y},
+                       GraphicPrimitive::Point{area.corner.x, area.bottom()}, GraphicPrimitive::Point{area.right(), area.bottom()}}) {
+        distance = std::min(distance, distanceToSegment(corner, line.p1(), line.p2()));
+    }
+    return distance <= half;
+}
+
+/*!
+Проверяет, задевает ли прямоугольная фигура область. Без заливки область, целиком лежащая внутри контура, не задета
+\param figure прямоугольник или квадрат
+\param box прямоугольник фигуры без контура
+\param area область
+\return <i>bool</i>
+*/
+inline bool intersectsBox(const GraphicPrimitive::Figure& figure, const Area& box, const Area& area) {
+    double half = outlineHalfWidth(figure);
+    Area outer = {{box.corner.x - half, box.corner.y - half}, box.width + 2 * half, box.height + 2 * half};
+    if(!outer.intersects(area)) {
+        return false;
+    }
+
+    Area inner = {{box.corner.x + half, box.corner.y + half}, box.width - 2 * half, box.height - 2 * half};
+    return figure.brushType() != GraphicPrimitive::BrushType::None || !inner.contains(area);
+}
+
+inline bool intersectsArea(const GraphicPrimitive::Rectangle& rectangle, const Area& area) {
+    return intersectsBox(rectangle, {rectangle.corner(), rectangle.width(), rectangle.height()}, area);
+}
+
+inline bool intersectsArea(const GraphicPrimitive::Square& square, const Area& area) {
+    return intersectsBox(square, {square.corner(), square.width(), square.width()}, area);
+}
+
+/*!
+Проверяет, задевает ли эллиптическая фигура область. Масштабирование осей переводит эллипс в единичную окружность,
+а область - снова в прямоугольник, поэтому ближайшая и дальняя точки области находятся покоординатно.
+Без заливки область, целиком лежащая внутри внутреннего края контура, не задета
+\param figure окружность или эллипс
+\param center центр
+\param radiusX радиус по оси x
+\param radiusY радиус по оси y
+\param area область
+\return <i>bool</i>
+*/
+inline bool intersectsEllipse(const GraphicPrimitive::Figure& figure, const GraphicPrimitive::Point& center, double radiusX, double radiusY, const Area& area) {
+    double half = outlineHalfWidth(figure);
+    double outerX = radiusX + half;
+    double outerY = radiusY + half;
+    if(outerX <= 0 || outerY <= 0) {
+        return false;
+    }
+
+    double nearX = (std::clamp(center.x, area.corner.x, area.right()) - center.x) / outerX;
+    double nearY = (std::clamp(center.y, area.corner.y, area.bottom()) - center.y) / outerY;
+    if(nearX * nearX + nearY * nearY > 1) {
+        return false;
+    }
+
+    double innerX = radiusX - half;
+    double innerY = radiusY - half;
+    if(figure.brushType() != GraphicPrimitive::BrushType::None || innerX <= 0 || innerY <= 0) {
+        return true;
+    }
+
+    double farX = std::max(std::abs(area.corner.x - center.x), std::abs(area.right() - center.x)) / innerX;
+    double farY = std::max(std::abs(area.corner.y - center.y), std::abs(area.bottom() - center.y)) / innerY;
+    return farX * farX + farY * farY >= 1;
+}
+
+inline bool intersectsArea(const GraphicPrimitive::Circle& circle, const Area& area) {
+    return intersectsEllipse(circle, circle.center(), circle.radius(), circle.radius(), area);
+}
+
+inline bool intersectsArea(const GraphicPrimitive::Ellipse& ellipse, const Area& area) {
+    return intersectsEllipse(ellipse, ellipse.center(), ellipse.radiusX(), ellipse.radiusY(), area);
+}
+
+/*!
+Проверяет, задевает ли графический примитив, хранимый по значению, область
+\param figure графический примитив
+\param area область
+\return <i>bool</i>
+*/
+inline bool intersectsArea(const GraphicPrimitive::FigureValue& figure, const Area& area) {
+    return std::visit([&area](const auto& value) { return intersectsArea(value, area); }, figure);
+}
+
+}
@@ -1,8 +1,17 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <type_traits>
 
 #include "GraphicPrimitives/GraphicPrimitives.h"
+#include "SpanFill.h"
+#include "Stroke.h"
 /*!
 \brief Компоненты графического интерфейса
 \author Алексей Волков
@@ -34,30 +43,419 @@ struct Area {
     {
 
     }
+
+/*!
+Возвращает <i>true</i>, если область не содержит ни одной точки
+\return <i>bool</i>
+*/
+    bool isEmpty() const {
+        return width <= 0 || height <= 0;
+    }
+
+/*!
+Возвращает координату x правой границы области
+\return <i>double</i>
+*/
+    double right() const {
+        return corner.x + width;
+    }
+
+/*!
+Возвращает координату y нижней границы области
+\return <i>double</i>
+*/
+    double bottom() const {
+        return corner.y + height;
+    }
+
+/*!
+Возвращает <i>true</i>, если области пересекаются
+\param other другая область
+\return <i>bool</i>
+*/
+    bool intersects(const Area& other) const {
+        return !isEmpty() && !other.isEmpty() &&
+               corner.x < other.right() && other.corner.x < right() &&
+               corner.y < other.bottom() && other.corner.y < bottom();
+    }
+
+/*!
+Возвращает <i>true</i>, если другая непустая область целиком лежит внутри области
+\param other другая область
+\return <i>bool</i>
+*/
+    bool contains(const Area& other) const {
+        return !other.isEmpty() &&
+               corner.x <= other.corner.x && other.right() <= right() &&
+               corner.y <= other.corner.y && other.bottom() <= bottom();
+    }
+
+/*!
+Возвращает пересечение областей, пустую область если они не пересекаются
+\param other другая область
+\return <i>Area</i>
+*/
+    Area intersected(const Area& other) const {
+        if(!intersects(other)) {
+            return {};
+        }
+
+        double x0 = std::max(corner.x, other.corner.x);
+        double y0 = std::max(corner.y, other.corner.y);
+        double x1 = std::min(right(), other.right());
+        double y1 = std::min(bottom(), other.bottom());
+        return {{x0, y0}, x1 - x0, y1 - y0};
+    }
+
+/*!
+Возвращает наименьшую область, содержащую обе области
+\param other другая область
+\return <i>Area</i>
+*/
+    Area united(const Area& other) const {
+        if(isEmpty()) {
+            return other;
+        }
+        if(other.isEmpty()) {
+            return *this;
+        }
+
+        double x0 = std::min(corner.x, other.corner.x);
+        double y0 = std::min(corner.y, other.corner.y);
+        double x1 = std::max(right(), other.right());
+        double y1 = std::max(bottom(), other.bottom());
+        return {{x0, y0}, x1 - x0, y1 - y0};
+    }
+
+/*!
+Возвращает область, расширенную до целых пикселей
+\return <i>Area</i>
+*/
+    Area aligned() const {
+        if(isEmpty()) {
+            return {};
+        }
+
+        double x0 = std::floor(corner.x);
+        double y0 = std::floor(corner.y);
+        return {{x0, y0}, std::ceil(right()) - x0, std::ceil(bottom()) - y0};
+    }
+};
+
+/*!
+Возвращает пустую область для невалидного графического примитива
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::InvalidFigure&) {
+    return {};
+}
+
+/*!
+Возвращает область, которую занимает отрезок вместе с толщиной кисти
+\param line отрезок
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::Line& line) {
+    double half = std::max(line.penWidth(), 1.0f) / 2;
+    double x0 = std::min(line.p1().x, line.p2().x) - half;
+    double y0 = std::min(line.p1().y, line.p2().y) - half;
+    double x1 = std::max(line.p1().x, line.p2().x) + half;
+    double y1 = std::max(line.p1().y, line.p2().y) + half;
+    return {{x0, y0}, x1 - x0, y1 - y0};
+}
+
+/*!
+Возвращает область, которую занимает прямоугольник вместе с рамкой
+\param rectangle прямоугольник
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::Rectangle& rectangle) {
+    double half = rectangle.penType() == GraphicPrimitive::PenType::None ? 0 : std::max(rectangle.penWidth(), 1.0f) / 2;
+    return {{rectangle.corner().x - half, rectangle.corner().y - half}, rectangle.width() + 2 * half, rectangle.height() + 2 * half};
+}
+
+/*!
+Возвращает область, которую занимает квадрат вместе с рамкой
+\param square квадрат
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::Square& square) {
+    double half = square.penType() == GraphicPrimitive::PenType::None ? 0 : std::max(square.penWidth(), 1.0f) / 2;
+    return {{square.corner().x - half, square.corner().y - half}, square.width() + 2 * half, square.width() + 2 * half};
+}
+
+/*!
+Возвращает область, которую занимает окружность вместе с контуром
+\param circle окружность
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::Circle& circle) {
+    double half = circle.penType() == GraphicPrimitive::PenType::None ? 0 : std::max(circle.penWidth(), 1.0f) / 2;
+    double radius = circle.radius() + half;
+    return {{circle.center().x - radius, circle.center().y - radius}, 2 * radius, 2 * radius};
+}
+
+/*!
+Возвращает область, которую занимает эллипс вместе с контуром
+\param ellipse эллипс
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::Ellipse& ellipse) {
+    double half = ellipse.penType() == GraphicPrimitive::PenType::None ? 0 : std::max(ellipse.penWidth(), 1.0f) / 2;
+    double radiusX = ellipse.radiusX() + half;
+    double radiusY = ellipse.radiusY() + half;
+    return {{ellipse.center().x - radiusX, ellipse.center().y - radiusY}, 2 * radiusX, 2 * radiusY};
+}
+
+/*!
+Возвращает область графического примитива, хранимого по значению. Тип выбирается статически через <i>std::visit</i>
+\param figure графический примитив
+\return <i>Area</i>
+*/
+inline Area figureBounds(const GraphicPrimitive::FigureValue& figure) {
+    return std::visit([](const auto& value) { return figureBounds(value); }, figure);
+}
+
+/*!
+Возвращает цвет, которым фигура представляется одной точкой при уменьшении: цвет кисти, а без контура цвет заливки
+\param figure графический примитив
+\return <i>uint32_t</i>
+*/
+inline uint32_t figureColor(const GraphicPrimitive::FigureValue& figure) {
+    return std::visit([](const auto& value) -> uint32_t {
+        if constexpr (std::is_same_v<std::decay_t<decltype(value)>, GraphicPrimitive::InvalidFigure>) {
+            return 0;
+        }
+        else if constexpr (std::is_same_v<std::decay_t<decltype(value)>, GraphicPrimitive::Line>) {
+            return value.penColor();
+        }
+        else {
+            return value.penType() != GraphicPrimitive::PenType::None ? value.penColor() : value.brushColor();
+        }
+    }, figure);
+}
+
+/*!
+\brief Узор заливки
+
+Узор 8x8 пикселей: элемент массива - строка узора, бит i строки отвечает за столбец i. Узор привязан к сетке пикселей холста,
+поэтому фигуры и плитки, нарисованные по отдельности, продолжают одну и ту же штриховку
+*/
+using BrushPattern = std::array<uint8_t, 8>;
+
+/*!
+Возвращает узор заливки для типа заливки: горизонтальная штриховка - каждая восьмая строка,
+вертикальная - каждый восьмой столбец
+\param type тип заливки
+\return <i>const BrushPattern&</i>
+*/
+inline const BrushPattern& brushPattern(GraphicPrimitive::BrushType type) {
+    static const BrushPattern patterns[] = {
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // None
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, // Solid
+        {0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Horizontal
+        {0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01}  // Vertical
+    };
+    return patterns[size_t(type)];
+}
+
+/*!
+\brief Правила упрощения отрисовки при уменьшении
+
+Действуют только при масштабе меньше 1, в натуральную величину фигуры рисуются без упрощений
+*/
+struct LevelOfDetail {
+    double pointSize = 2;         ///< фигура, область которой на холсте меньше этого размера по обеим осям, рисуется одним пикселем
+    double patternScale = 0.5;    ///< при масштабе меньше этого штриховки заливаются сплошным цветом, а пунктир рисуется сплошной кистью
+    double aggregateCellSize = 4; ///< если ячейка пространственного индекса на холсте меньше этого размера, вместо фигур рисуются грубые представления ячеек
+};
+
+/*!
+\brief Преобразование координат сцены в координаты холста
+
+Масштаб и сдвиг: точка сцены <i>origin</i> отображается в левый верхний угол холста, одна единица сцены занимает <i>scale</i> пикселей
+*/
+struct Transform {
+    GraphicPrimitive::Point origin = {0, 0};
+    double scale = 1;
+
+/*!
+Переводит точку сцены в координаты холста
+\param point точка сцены
+\return <i>GraphicPrimitive::Point</i>
+*/
+    GraphicPrimitive::Point map(const GraphicPrimitive::Point& point) const {
+        return {(point.x - origin.x) * scale, (point.y - origin.y) * scale};
+    }
+
+/*!
+Переводит точку холста в координаты сцены
+\param point точка холста
+\return <i>GraphicPrimitive::Point</i>
+*/
+    GraphicPrimitive::Point unmap(const GraphicPrimitive::Point& point) const {
+        return {point.x / scale + origin.x, point.y / scale + origin.y};
+    }
+
+/*!
+Переводит область сцены в координаты холста
+\param area область сцены
+\return <i>Area</i>
+*/
+    Area map(const Area& area) const {
+        if(area.isEmpty()) {
+            return {};
+        }
+
+        return {map(area.corner), area.width * scale, area.height * scale};
+    }
+
+/*!
+Переводит область холста в координаты сцены
+\param area область холста
+\return <i>Area</i>
+*/
+    Area unmap(const Area& area) const {
+        if(area.isEmpty()) {
+            return {};
+        }
+
+        return {unmap(area.corner), area.width / scale, area.height / scale};
+    }
+
+/*!
+Переводит область фигуры, вычисленную <i>figureBounds</i>, в область на холсте. Контур на холсте не тоньше пикселя,
+поэтому при уменьшении область расширяется на полпикселя, при масштабе не меньше 1 совпадает с <i>map</i>
+\param bounds область фигуры в координатах сцены
+\return <i>Area</i>
+*/
+    Area mapBounds(const Area& bounds) const {
+        Area area = map(bounds);
+        if(scale >= 1 || area.isEmpty()) {
+            return area;
+        }
+
+        return {{area.corner.x - 0.5, area.corner.y - 0.5}, area.width + 1, area.height + 1};
+    }
 };
 
 /*!
 \brief Класс холста
 
-Класс холста, необходим для отрисовки графических примитивов, содержит ширину и высоту
+Класс холста, необходим для отрисовки графических примитивов, содержит ширину, высоту и буфер 32-битных пикселей RGBA.
+Старший байт пикселя - альфа, цветовые каналы хранятся умноженными на альфу
 */
 class Canvas {
     uint32_t m_width;
     uint32_t m_height;
+    std::vector<uint32_t> m_pixels;
 
 public:
-    Canvas(uint32_t width, uint32_t height) : m_width(width), m_height(height) {
+    Canvas(uint32_t width, uint32_t height) : m_width(width), m_height(height), m_pixels(size_t(width) * height, 0) {
 
     }
+
+    uint32_t width() const {
+        return m_width;
+    }
+
+    uint32_t height() const {
+        return m_height;
+    }
+
+/*!
+Возвращает указатель на начало строки пикселей
+\param y номер строки
+\return <i>uint32_t*</i>
+*/
+    uint32_t* scanline(uint32_t y) {
+        return m_pixels.data() + size_t(y) * m_width;
+    }
+
+    const uint32_t* scanline(uint32_t y) const {
+        return m_pixels.data() + size_t(y) * m_width;
+    }
+
+/*!
+Возвращает цвет пикселя
+\param x координата x пикселя
+\param y координата y пикселя
+\return <i>uint32_t</i>
+*/
+    uint32_t pixel(uint32_t x, uint32_t y) const {
+        return m_pixels[size_t(y) * m_width + x];
+    }
+
+/*!
+Возвращает область, занимаемую холстом
+\return <i>Area</i>
+*/
+    Area area() const {
+        return {{0, 0}, double(m_width), double(m_height)};
+    }
+/*!
+Сдвигает изображение на целое число пикселей. Пиксели, на которые не попало сдвинутое изображение, не изменяются
+\param dx сдвиг по оси x
+\param dy сдвиг по оси y
+\return <i>void</i>
+*/
+    void scroll(int dx, int dy) {
+        int width = int(m_width) - std::abs(dx);
+        int height = int(m_height) - std::abs(dy);
+        if(width <= 0 || height <= 0) {
+            return;
+        }
+
+        int sourceX = std::max(-dx, 0);
+        int targetX = std::max(dx, 0);
+        for(int i = 0; i < height; i++) {
+            int y = dy > 0 ? height - 1 - i : i;
+            std::memmove(scanline(uint32_t(y + std::max(dy, 0))) + targetX, scanline(uint32_t(y + std::max(-dy, 0))) + sourceX, size_t(width) * sizeof(uint32_t));
+        }
+    }
 };
 
 /*!
 \brief Класс художника
 
-Класс художника, отрисовывает графические примитивы на холсте
+Класс художника, отрисовывает графические примитивы на холсте. Заливка выполняется горизонтальными отрезками,
+пиксель считается закрашенным, если его центр попадает внутрь фигуры. Примитивы задаются в координатах сцены
+и переводятся в координаты холста преобразованием художника. Контуры толщиной больше пикселя и пунктир собираются
+в буфер отрезков строк и заливаются одним проходом, штриховки заливаются по маске узора. При уменьшении мелкие фигуры рисуются точкой,
+а штриховки и пунктир упрощаются по правилам <i>LevelOfDetail</i>. Все операции ограничиваются областью отсечения.
+Старший байт цвета кисти и заливки - альфа: непрозрачные цвета записываются в холст, полупрозрачные накладываются
+на изображение правилом source-over
 */
 class Painter {
+    /// Область отсечения в целых пикселях, правая и нижняя границы не включаются
+    struct ClipRect {
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = 0;
+        int y1 = 0;
+    };
+
+    /// Параметры кисти и заливки, с которыми рисуется фигура, цвета умножены на альфу
+    struct Style {
+        uint32_t penColor = 0;
+        GraphicPrimitive::PenType penType = GraphicPrimitive::PenType::None;
+        float penWidth = 0;
+        uint32_t brushColor = 0;
+        GraphicPrimitive::BrushType brushType = GraphicPrimitive::BrushType::None;
+    };
+
+    /// Предел координат концов тонкого отрезка на холсте: шаги по отрезку в пределах квадрата помещаются в int64_t
+    static constexpr double SegmentLimit = double(1 << 29);
+
     std::shared_ptr<Canvas> m_canvas;
+    Area m_clip;
+    bool m_hasClip = false;
+    ClipRect m_clipRect;
+    Transform m_transform;
+    LevelOfDetail m_detail;
+    SpanBuffer m_spans;
+    int m_patternX = 0;
+    int m_patternY = 0;
 
 public:
 /*!
@@ -65,7 +463,11 @@ public:
 \return <i>void</i>
 */
     void clearAll() {
+        if(!m_canvas) {
+            return;
+        }
 
+        Simd::fillSpan(m_canvas->scanline(0), size_t(m_canvas->width()) * m_canvas->height(), 0);
     }
 
  /*!
@@ -74,7 +476,10 @@ public:
 \return <i>void</i>
 */
     void clearArea(const Area& area) {
-
+        ClipRect rect = pixelRect(area);
+        for(int y = rect.y0; y < rect.y1; y++) {
+            Simd::fillSpan(m_canvas->scanline(uint32_t(y)) + rect.x0, size_t(rect.x1 - rect.x0), 0);
+        }
     }
 
  /*!
@@ -92,6 +497,97 @@ public:
 */
     void setCanvas(const std::shared_ptr<Canvas>& canvas) {
         m_canvas = canvas;
+        updateClipRect();
+    }
+
+ /*!
+Ограничивает рисование указанной областью холста
+\param area область отсечения
+\return <i>void</i>
+*/
+    void setClip(const Area& area) {
+        m_clip = area;
+        m_hasClip = true;
+        updateClipRect();
+    }
+
+ /*!
+Снимает ограничение области рисования
+\return <i>void</i>
+*/
+    void resetClip() {
+        m_hasClip = false;
+        updateClipRect();
+    }
+
+ /*!
+Устанавливает преобразование координат сцены в координаты холста, которое применяется ко всем рисуемым примитивам.
+Толщина кисти масштабируется вместе с фигурой. Область отсечения задается в координатах холста
+\param transform преобразование координат
+\return <i>void</i>
+*/
+    void setTransform(const Transform& transform) {
+        m_transform = transform;
+    }
+
+    const Transform& transform() const {
+        return m_transform;
+    }
+
+ /*!
+Привязывает узоры заливки к пикселю холста. По умолчанию узоры начинаются в левом верхнем углу холста
+\param x координата x пикселя
+\param y координата y пикселя
+\return <i>void</i>
+*/
+    void setPatternOrigin(int x, int y) {
+        m_patternX = x & 7;
+        m_patternY = y & 7;
+    }
+
+ /*!
+Устанавливает правила упрощения отрисовки при уменьшении
+\param detail правила упрощения
+\return <i>void</i>
+*/
+    void setLevelOfDetail(const LevelOfDetail& detail) {
+        m_detail = detail;
+    }
+
+    const LevelOfDetail& levelOfDetail() const {
+        return m_detail;
+    }
+
+ /*!
+Заливает область холста цветом с учетом области отсечения, полупрозрачный цвет накладывается на изображение
+\param area область в координатах холста
+\param color цвет заливки, старший байт - альфа
+\return <i>void</i>
+*/
+    void fillArea(const Area& area, uint32_t color) {
+        if(!m_canvas) {
+            return;
+        }
+
+        fillRect(pixelRect(area), Simd::premultiply(color));
+    }
+
+ /*!
+Отрисовка графического примитива, хранимого по значению. Нужная перегрузка <i>drawFigure</i> выбирается статически через <i>std::visit</i>,
+без RTTI. Для нового типа примитива достаточно добавить его в GraphicPrimitive::FigureValue и перегрузки <i>drawFigure</i> и <i>figureBounds</i>
+\param figure графический примитив
+\return <i>Area</i>
+*/
+    Area drawFigure(const GraphicPrimitive::FigureValue& figure) {
+        return std::visit([this](const auto& value) { return drawFigure(value); }, figure);
+    }
+
+ /*!
+Отрисовка невалидного графического примитива, ничего не рисует
+\return <i>Area</i>
+*/
+    Area drawFigure(const GraphicPrimitive::InvalidFigure&) {
+        return {};
     }
 
  /*!
@@ -100,7 +596,8 @@ public:
 \return <i>Area</i>
 */
     Area drawFigure(const GraphicPrimitive::Line& line) {
-        return {};
+        drawLine(m_transform.map(line.p1()), m_transform.map(line.p2()), styleOf(line));
+        return paintedArea(figureBounds(line));
     }
 
  /*!
@@ -109,7 +606,8 @@ public:
 \return <i>Area</i>
 */
     Area drawFigure(const GraphicPrimitive::Rectangle& rectangle) {
-        return {};
+        drawBox(m_transform.map(rectangle.corner()), rectangle.width() * m_transform.scale, rectangle.height() * m_transform.scale, styleOf(rectangle));
+        return paintedArea(figureBounds(rectangle));
     }
 
  /*!
@@ -118,7 +616,8 @@ public:
 \return <i>Area</i>
 */
     Area drawFigure(const GraphicPrimitive::Square& square) {
-        return {};
+        drawBox(m_transform.map(square.corner()), square.width() * m_transform.scale, square.width() * m_transform.scale, styleOf(square));
+        return paintedArea(figureBounds(square));
     }
 
  /*!
@@ -127,7 +626,8 @@ public:
 \return <i>Area</i>
 */
     Area drawFigure(const GraphicPrimitive::Circle& circle) {
-        return {};
+        drawOval(m_transform.map(circle.center()), circle.radius() * m_transform.scale, circle.radius() * m_transform.scale, styleOf(circle));
+        return paintedArea(figureBounds(circle));
     }
 
  /*!
@@ -136,7 +636,630 @@ public:
 \return <i>Area</i>
 */
     Area drawFigure(const GraphicPrimitive::Ellipse &ellipse) {
-        return {};
+        drawOval(m_transform.map(ellipse.center()), ellipse.radiusX() * m_transform.scale, ellipse.radiusY() * m_transform.scale, styleOf(ellipse));
+        return paintedArea(figureBounds(ellipse));
+    }
+
+private:
+ /*!
+Пересчитывает область отсечения в целых пикселях с учетом размеров холста
+\return <i>void</i>
+*/
+    void updateClipRect() {
+        m_clipRect = {};
+        if(!m_canvas) {
+            return;
+        }
+
+        m_clipRect.x1 = int(m_canvas->width());
+        m_clipRect.y1 = int(m_canvas->height());
+        if(m_hasClip) {
+            m_clipRect = pixelRect(m_clip);
+        }
+    }
+
+ /*!
+Переводит область в диапазон пикселей, центры которых в нее попадают, с учетом области отсечения
+\param area область
+\return <i>ClipRect</i>
+*/
+    ClipRect pixelRect(const Area& area) const {
+        ClipRect rect;
+        if(!m_canvas || area.isEmpty()) {
+            return rect;
+        }
+
+        rect.x0 = std::max(m_clipRect.x0, pixelEdge(area.corner.x));
+        rect.y0 = std::max(m_clipRect.y0, pixelEdge(area.corner.y));
+        rect.x1 = std::min(m_clipRect.x1, pixelEdge(area.right()));
+        rect.y1 = std::min(m_clipRect.y1, pixelEdge(area.bottom()));
+        rect.x1 = std::max(rect.x0, rect.x1);
+        rect.y1 = std::max(rect.y0, rect.y1);
+        return rect;
+    }
+
+ /*!
+Возвращает номер первого пикселя, центр которого лежит не левее координаты
+\param coordinate координата
+\return <i>int</i>
+*/
+    static int pixelEdge(double coordinate) {
+        return int(std::clamp(std::ceil(coordinate - 0.5), -1.0e9, 1.0e9));
+    }
+
+ /*!
+Возвращает выровненную по пикселям часть области фигуры, попавшую на холст
+\param bounds область фигуры в координатах сцены
+\return <i>Area</i>
+*/
+    Area paintedArea(const Area& bounds) const {
+        if(!m_canvas) {
+            return {};
+        }
+
+        return m_transform.mapBounds(bounds).aligned().intersected(m_canvas->area());
+    }
+
+ /*!
+Заливает строки прямоугольника пикселей
+\param rect прямоугольник внутри области отсечения
+\param color цвет заливки, умноженный на альфу
+\return <i>void</i>
+*/
+    void fillRect(const ClipRect& rect, uint32_t color) {
+        for(int y = rect.y0; y < rect.y1; y++) {
+            Simd::compositeSpan(m_canvas->scanline(uint32_t(y)) + rect.x0, size_t(rect.x1 - rect.x0), color);
+        }
+    }
+
+ /*!
+Заливает отрезок строки с учетом области отсечения
+\param y номер строки
+\param x0 первый пиксель отрезка
+\param x1 пиксель за последним пикселем отрезка
+\param color цвет заливки, умноженный на альфу
+\return <i>void</i>
+*/
+    void fillSpan(int y, int x0, int x1, uint32_t color) {
+        if(y < m_clipRect.y0 || y >= m_clipRect.y1) {
+            return;
+        }
+
+        x0 = std::max(x0, m_clipRect.x0);
+        x1 = std::min(x1, m_clipRect.x1);
+        if(x0 >= x1) {
+            return;
+        }
+
+        Simd::compositeSpan(m_canvas->scanline(uint32_t(y)) + x0, size_t(x1 - x0), color);
+    }
+
+ /*!
+Заливает отрезок строки цветом заливки по узору заливки с учетом области отсечения. Строка узора сдвигается
+по номеру первого пикселя, пустые строки пропускаются, а сплошные заливаются без маски
+\param y номер строки
+\param x0 первый пиксель отрезка
+\param x1 пиксель за последним пикселем отрезка
+\param style параметры заливки
+\return <i>void</i>
+*/
+    void fillBrushSpan(int y, int x0, int x1, const Style& style) {
+        uint8_t mask = brushPattern(style.brushType)[size_t((y - m_patternY) & 7)];
+        if(mask == 0xFF) {
+            fillSpan(y, x0, x1, style.brushColor);
+            return;
+        }
+        if(mask == 0 || y < m_clipRect.y0 || y >= m_clipRect.y1) {
+            return;
+        }
+
+        x0 = std::max(x0, m_clipRect.x0);
+        x1 = std::min(x1, m_clipRect.x1);
+        if(x0 >= x1) {
+            return;
+        }
+
+        int phase = (x0 - m_patternX) & 7;
+        mask = uint8_t((mask >> phase) | (mask << (8 - phase)));
+        Simd::compositeSpanMasked(m_canvas->scanline(uint32_t(y)) + x0, size_t(x1 - x0), style.brushColor, mask);
+    }
+
+ /*!
+Добавляет в буфер контура часть отрезка строки, попавшую в область отсечения и на штрихи шаблона кисти
+\param y номер строки
+\param x0 первый пиксель отрезка
+\param x1 пиксель за последним пикселем отрезка
+\param dashes шаблон кисти
+\param position положение центра пикселя на контуре, монотонное на отрезке
+\return <i>void</i>
+*/
+    template<typename Position>
+    void addPenSpan(int y, int x0, int x1, const StrokeDashes& dashes, Position position) {
+        if(y < m_clipRect.y0 || y >= m_clipRect.y1) {
+            return;
+        }
+
+        m_spans.add(y, std::max(x0, m_clipRect.x0), std::min(x1, m_clipRect.x1), dashes, position);
+    }
+
+ /*!
+Добавляет в буфер контура одинаковые строки полосы. Положение на контуре зависит только от x,
+поэтому штрихи вычисляются для первой строки, а остальные ее повторяют
+\param y0 первая строка полосы
+\param y1 строка за последней строкой полосы
+\param x0 первый пиксель строк
+\param x1 пиксель за последним пикселем строк
+\param dashes шаблон кисти
+\param position положение центра пикселя на контуре
+\return <i>void</i>
+*/
+    template<typename Position>
+    void addPenBand(int y0, int y1, int x0, int x1, const StrokeDashes& dashes, Position position) {
+        y0 = std::max(y0, m_clipRect.y0);
+        y1 = std::min(y1, m_clipRect.y1);
+        if(y0 >= y1) {
+            return;
+        }
+
+        size_t first = m_spans.size();
+        addPenSpan(y0, x0, x1, dashes, position);
+        size_t last = m_spans.size();
+        for(int y = y0 + 1; y < y1; y++) {
+            m_spans.repeat(first, last, y);
+        }
+    }
+
+ /*!
+Заливает собранные в буфере отрезки контура и очищает буфер. Отрезки не пересекаются, поэтому полупрозрачная
+кисть накладывается на каждый пиксель один раз
+\param color цвет кисти, умноженный на альфу
+\return <i>void</i>
+*/
+    void fillPenSpans(uint32_t color) {
+        for(const Span& span : m_spans.spans()) {
+            Simd::compositeSpan(m_canvas->scanline(uint32_t(span.y)) + span.x0, size_t(span.x1 - span.x0), color);
+        }
+        m_spans.clear();
+    }
+
+ /*!
+Возвращает параметры кисти и заливки графического примитива, толщина кисти переводится в пиксели холста,
+цвета умножаются на альфу
+\param figure графический примитив
+\return <i>Style</i>
+*/
+    Style styleOf(const GraphicPrimitive::Figure& figure) const {
+        return simplified({Simd::premultiply(figure.penColor()), figure.penType(), float(figure.penWidth() * m_transform.scale),
+                           Simd::premultiply(figure.brushColor()), figure.brushType()});
+    }
+
+ /*!
+Упрощает параметры кисти и заливки при масштабе меньше <i>LevelOfDetail::patternScale</i>: пунктир становится сплошной кистью,
+штриховка - сплошной заливкой
+\param style параметры кисти и заливки
+\return <i>Style</i>
+*/
+    Style simplified(Style style) const {
+        if(m_transform.scale >= m_detail.patternScale) {
+            return style;
+        }
+
+        if(style.penType != GraphicPrimitive::PenType::None) {
+            style.penType = GraphicPrimitive::PenType::Solid;
+        }
+        if(style.brushType != GraphicPrimitive::BrushType::None) {
+            style.brushType = GraphicPrimitive::BrushType::Solid;
+        }
+        return style;
+    }
+
+ /*!
+Рисует фигуру одним пикселем, если при уменьшении ее область на холсте меньше <i>LevelOfDetail::pointSize</i> по обеим осям.
+Пиксель берется под центром области, цвет - цвет кисти, а без контура цвет заливки
+\param bounds область фигуры на холсте вместе с контуром
+\param style параметры кисти и заливки
+\return <i>bool</i> <i>true</i>, если фигура нарисована точкой
+*/
+    bool drawPoint(const Area& bounds, const Style& style) {
+        if(m_transform.scale >= 1 || bounds.width >= m_detail.pointSize || bounds.height >= m_detail.pointSize) {
+            return false;
+        }
+
+        if(style.penType != GraphicPrimitive::PenType::None) {
+            plot(bounds, style.penColor);
+        }
+        else if(style.brushType != GraphicPrimitive::BrushType::None) {
+            plot(bounds, style.brushColor);
+        }
+        return true;
+    }
+
+ /*!
+Закрашивает пиксель под центром области
+\param bounds область на холсте
+\param color цвет
+\return <i>void</i>
+*/
+    void plot(const Area& bounds, uint32_t color) {
+        int x = int(std::clamp(std::floor(bounds.corner.x + bounds.width / 2), -1.0e9, 1.0e9));
+        int y = int(std::clamp(std::floor(bounds.corner.y + bounds.height / 2), -1.0e9, 1.0e9));
+        fillSpan(y, x, x + 1, color);
+    }
+
+ /*!
+Рисует отрезок кистью. Отрезок толщиной не больше пикселя рисуется по шагам вдоль длинной оси, более толстый - как
+прямоугольник со срезанными концами: для каждой строки пересечение с полосой отрезка находится из двух пар линейных
+неравенств. Пунктир отсчитывается от начала отрезка
+\param p1 начало отрезка на холсте
+\param p2 конец отрезка на холсте
+\param style параметры кисти
+\return <i>void</i>
+*/
+    void drawLine(const GraphicPrimitive::Point& p1, const GraphicPrimitive::Point& p2, const Style& style) {
+        if(!m_canvas || style.penType == GraphicPrimitive::PenType::None) {
+            return;
+        }
+
+        StrokeDashes dashes = strokeDashes(style.penType, std::max(style.penWidth, 1.0f));
+        if(style.penWidth <= 1) {
+            drawSegment(p1, p2, style.penColor, dashes);
+            return;
+        }
+
+        double half = style.penWidth / 2.0;
+        double length = std::hypot(p2.x - p1.x, p2.y - p1.y);
+        if(length == 0) {
+            fillRect(pixelRect({{p1.x - half, p1.y - half}, 2 * half, 2 * half}), style.penColor);
+            return;
+        }
+
+        double ux = (p2.x - p1.x) / length;
+        double uy = (p2.y - p1.y) / length;
+        double x0 = std::min(p1.x, p2.x) - half;
+        double y0 = std::min(p1.y, p2.y) - half;
+        ClipRect rows = pixelRect({{x0, y0}, std::max(p1.x, p2.x) + half - x0, std::max(p1.y, p2.y) + half - y0});
+        for(int y = rows.y0; y < rows.y1; y++) {
+            double dy = y + 0.5 - p1.y;
+            double from = -std::numeric_limits<double>::infinity();
+            double to = std::numeric_limits<double>::infinity();
+            limitSpan(from, to, ux, dy * uy - p1.x * ux, 0, length);
+            limitSpan(from, to, -uy, dy * ux + p1.x * uy, -half, half);
+            if(from >= to) {
+                continue;
+            }
+
+            addPenSpan(y, pixelEdge(from), pixelEdge(to), dashes, [&p1, ux, dy, uy](int x) {
+                return (x + 0.5 - p1.x) * ux + dy * uy;
+            });
+        }
+        fillPenSpans(style.penColor);
+    }
+
+ /*!
+Сужает промежуток координат x до точек, для которых <i>lower <= a * x + b <= upper</i>
+\param from начало промежутка
+\param to конец промежутка
+\param a коэффициент при x
+\param b свободный член
+\param lower нижняя граница
+\param upper верхняя граница
+\return <i>void</i>
+*/
+    static void limitSpan(double& from, double& to, double a, double b, double lower, double upper) {
+        if(std::abs(a) < 1e-12) {
+            if(b < lower || b > upper) {
+                to = from;
+            }
+            return;
+        }
+
+        double first = (lower - b) / a;
+        double last = (upper - b) / a;
+        if(a < 0) {
+            std::swap(first, last);
+        }
+        from = std::max(from, first);
+        to = std::min(to, last);
+    }
+
+ /*!
+Рисует отрезок толщиной в один пиксель: по одному пикселю на каждый шаг вдоль длинной оси, координата по короткой оси
+округляется до ближайшей. Пиксель отрезка вычисляется независимо от остальных, поэтому перебираются только шаги, попавшие
+в область отсечения, а результат не зависит от того, рисуется отрезок целиком или по плиткам. Непрозрачный цвет
+записывается в пиксель, полупрозрачный накладывается на него
+\param p1 начало отрезка
+\param p2 конец отрезка
+\param color цвет кисти, умноженный на альфу
+\param dashes шаблон кисти
+\return <i>void</i>
+*/
+    void drawSegment(const GraphicPrimitive::Point& p1, const GraphicPrimitive::Point& p2, uint32_t color, const StrokeDashes& dashes) {
+        uint32_t alpha = color >> 24;
+        if(alpha == 255) {
+            strokeSegment(p1, p2, dashes, [color](uint32_t& pixel) {
+                pixel = color;
+            });
+        }
+        else if(alpha != 0) {
+            strokeSegment(p1, p2, dashes, [color](uint32_t& pixel) {
+                pixel = Simd::blendPixel(pixel, color);
+            });
+        }
+    }
+
+ /*!
+Закрашивает пиксели отрезка толщиной в один пиксель, попавшие на штрихи шаблона. Для пунктира штрих
+выбирается по проекции центра пикселя на отрезок
+\param p1 начало отрезка
+\param p2 конец отрезка
+\param dashes шаблон кисти
+\param paint функция закрашивания пикселя
+\return <i>void</i>
+*/
+    template<typename Paint>
+    void strokeSegment(const GraphicPrimitive::Point& p1, const GraphicPrimitive::Point& p2, const StrokeDashes& dashes, Paint paint) {
+        if(dashes.isSolid()) {
+            drawSegment(p1, p2, [this, &paint](int64_t x, int64_t y) {
+                paint(m_canvas->scanline(uint32_t(y))[x]);
+            });
+            return;
+        }
+
+        double length = std::hypot(p2.x - p1.x, p2.y - p1.y);
+        double ux = length > 0 ? (p2.x - p1.x) / length : 0;
+        double uy = length > 0 ? (p2.y - p1.y) / length : 0;
+        drawSegment(p1, p2, [this, &paint, &dashes, &p1, ux, uy](int64_t x, int64_t y) {
+            if(StrokeDashes::isDash(dashes.segment((x + 0.5 - p1.x) * ux + (y + 0.5 - p1.y) * uy))) {
+                paint(m_canvas->scanline(uint32_t(y))[x]);
+            }
+        });
+    }
+
+ /*!
+Перебирает пиксели отрезка толщиной в один пиксель, попавшие в область отсечения. Концы отрезка переводятся в пиксели
+только в пределах <i>SegmentLimit</i>, где целочисленные шаги не переполняются
+\param p1 начало отрезка
+\param p2 конец отрезка
+\param plot функция закраски пикселя с параметрами (x, y)
+\return <i>void</i>
+*/
+    template<typename Plot>
+    void drawSegment(GraphicPrimitive::Point p1, GraphicPrimitive::Point p2, Plot plot) {
+        if(!limitSegment(p1, p2)) {
+            return;
+        }
+
+        int64_t x0 = int64_t(std::floor(p1.x));
+        int64_t y0 = int64_t(std::floor(p1.y));
+        int64_t x1 = int64_t(std::floor(p2.x));
+        int64_t y1 = int64_t(std::floor(p2.y));
+
+        if(std::abs(x1 - x0) >= std::abs(y1 - y0)) {
+            drawSegmentSteps(x0, y0, x1, y1, m_clipRect.x0, m_clipRect.x1, m_clipRect.y0, m_clipRect.y1, plot);
+        }
+        else {
+            drawSegmentSteps(y0, x0, y1, x1, m_clipRect.y0, m_clipRect.y1, m_clipRect.x0, m_clipRect.x1, [&plot](int64_t y, int64_t x) {
+                plot(x, y);
+            });
+        }
+    }
+
+ /*!
+Отсекает отрезок квадратом <i>[-SegmentLimit, SegmentLimit]</i> в координатах холста, возвращает <i>false</i>, если отрезок
+его не пересекает. Отсечение выполняется в double и только для концов за пределами квадрата, поэтому остальные отрезки
+рисуются без изменений. Квадрат не зависит от области отсечения, поэтому отрезок одинаково рисуется целиком и по плиткам
+\param p1 начало отрезка
+\param p2 конец отрезка
+\return <i>bool</i>
+*/
+    static bool limitSegment(GraphicPrimitive::Point& p1, GraphicPrimitive::Point& p2) {
+        auto inside = [](const GraphicPrimitive::Point& point) {
+            return std::abs(point.x) <= SegmentLimit && std::abs(point.y) <= SegmentLimit;
+        };
+        if(inside(p1) && inside(p2)) {
+            return true;
+        }
+        if(!std::isfinite(p1.x) || !std::isfinite(p1.y) || !std::isfinite(p2.x) || !std::isfinite(p2.y)) {
+            return false;
+        }
+
+        double dx = p2.x - p1.x;
+        double dy = p2.y - p1.y;
+        double from = 0;
+        double to = 1;
+        limitSpan(from, to, dx, p1.x, -SegmentLimit, SegmentLimit);
+        limitSpan(from, to, dy, p1.y, -SegmentLimit, SegmentLimit);
+        if(!(from < to)) {
+            return false;
+        }
+
+        GraphicPrimitive::Point start = {p1.x + from * dx, p1.y + from * dy};
+        GraphicPrimitive::Point end = {p1.x + to * dx, p1.y + to * dy};
+        p1 = {std::clamp(start.x, -SegmentLimit, SegmentLimit), std::clamp(start.y, -SegmentLimit, SegmentLimit)};
+        p2 = {std::clamp(end.x, -SegmentLimit, SegmentLimit), std::clamp(end.y, -SegmentLimit, SegmentLimit)};
+        return true;
+    }
+
+ /*!
+Перебирает пиксели отрезка вдоль длинной оси в пределах отсечения. Диапазон шагов сужается и по короткой оси,
+поэтому отрезок, проходящий мимо области отсечения, не перебирается
+\param major0 начало отрезка по длинной оси
+\param minor0 начало отрезка по короткой оси
+\param major1 конец отрезка по длинной оси
+\param minor1 конец отрезка по короткой оси
+\param majorBegin первый пиксель отсечения по длинной оси
+\param majorEnd пиксель за последним пикселем отсечения по длинной оси
+\param minorBegin первый пиксель отсечения по короткой оси
+\param minorEnd пиксель за последним пикселем отсечения по короткой оси
+\param plot функция закраски пикселя с параметрами (длинная ось, короткая ось)
+\return <i>void</i>
+*/
+    template<typename Plot>
+    static void drawSegmentSteps(int64_t major0, int64_t minor0, int64_t major1, int64_t minor1, int64_t majorBegin, int64_t majorEnd,
+                                 int64_t minorBegin, int64_t minorEnd, Plot plot) {
+        if(major0 > major1) {
+            std::swap(major0, major1);
+            std::swap(minor0, minor1);
+        }
+
+        int64_t length = major1 - major0;
+        int64_t rise = std::abs(minor1 - minor0);
+        int64_t step = minor0 < minor1 ? 1 : -1;
+        int64_t first = std::max(major0, majorBegin);
+        int64_t last = std::min(major1, majorEnd - 1);
+        if(rise > 0) {
+            int64_t from = (minorBegin - minor0) * step;
+            int64_t to = (minorEnd - 1 - minor0) * step;
+            if(from > to) {
+                std::swap(from, to);
+            }
+            first = std::max(first, major0 + (2 * from - 1) * length / (2 * rise) - 1);
+            last = std::min(last, major0 + (2 * to + 1) * length / (2 * rise) + 1);
+        }
+        for(int64_t major = first; major <= last; major++) {
+            int64_t minor = minor0;
+            if(length > 0) {
+                minor += step * ((2 * (major - major0) * rise + length) / (2 * length));
+            }
+            if(minor >= minorBegin && minor < minorEnd) {
+                plot(major, minor);
+            }
+        }
+    }
+
+ /*!
+Рисует прямоугольник с рамкой, центрированной на его границе. Горизонтальные полосы рамки вместе с углами занимают
+строки целиком, вертикальные - отрезки по краям остальных строк, поэтому углы соединяются без зазоров. Пунктир
+отсчитывается по периметру по часовой стрелке от левого верхнего угла
+\param corner левый верхний угол
+\param width ширина
+\param height высота
+\param style параметры кисти и заливки
+\return <i>void</i>
+*/
+    void drawBox(const GraphicPrimitive::Point& corner, double width, double height, const Style& style) {
+        if(!m_canvas) {
+            return;
+        }
+
+        bool hasPen = style.penType != GraphicPrimitive::PenType::None;
+        bool hasBrush = style.brushType != GraphicPrimitive::BrushType::None;
+        double half = hasPen ? std::max(style.penWidth, 1.0f) / 2 : 0;
+
+        Area bounds = {{corner.x - half, corner.y - half}, width + 2 * half, height + 2 * half};
+        if(drawPoint(bounds, style)) {
+            return;
+        }
+
+        ClipRect outer = pixelRect(bounds);
+        int innerX0 = pixelEdge(corner.x + half);
+        int innerY0 = pixelEdge(corner.y + half);
+        int innerX1 = std::max(innerX0, pixelEdge(corner.x + width - half));
+        int innerY1 = std::max(innerY0, pixelEdge(corner.y + height - half));
+        StrokeDashes dashes = strokeDashes(style.penType, 2 * half);
+
+        if(hasPen) {
+            addPenBand(outer.y0, std::min(innerY0, outer.y1), outer.x0, outer.x1, dashes, [&corner](int x) {
+                return x + 0.5 - corner.x;
+            });
+            addPenBand(std::max(innerY1, outer.y0), outer.y1, outer.x0, outer.x1, dashes, [&corner, width, height](int x) {
+                return width + height + (corner.x + width - (x + 0.5));
+            });
+        }
+
+        for(int y = std::max(innerY0, outer.y0); y < std::min(innerY1, outer.y1); y++) {
+            double rowCenter = y + 0.5;
+            if(hasPen) {
+                double left = 2 * width + height + (corner.y + height - rowCenter);
+                double right = width + (rowCenter - corner.y);
+                addPenSpan(y, outer.x0, innerX0, dashes, [left](int) {
+                    return left;
+                });
+                addPenSpan(y, innerX1, outer.x1, dashes, [right](int) {
+                    return right;
+                });
+            }
+            if(hasBrush) {
+                fillBrushSpan(y, innerX0, innerX1, style);
+            }
+        }
+        if(hasPen) {
+            fillPenSpans(style.penColor);
+        }
+    }
+
+ /*!
+Рисует эллипс с контуром, центрированным на его границе. Для каждой строки вычисляются отрезки внешнего и внутреннего эллипсов.
+Пунктир отсчитывается по длине дуги средней линии контура: положение пикселя на контуре определяется параметрическим углом
+его центра, для окружности длина дуги пропорциональна углу, для эллипса берется из таблицы
+\param center центр
+\param radiusX радиус по оси x
+\param radiusY радиус по оси y
+\param style параметры кисти и заливки
+\return <i>void</i>
+*/
+    void drawOval(const GraphicPrimitive::Point& center, double radiusX, double radiusY, const Style& style) {
+        if(!m_canvas) {
+            return;
+        }
+
+        bool hasPen = style.penType != GraphicPrimitive::PenType::None;
+        bool hasBrush = style.brushType != GraphicPrimitive::BrushType::None;
+        double half = hasPen ? std::max(style.penWidth, 1.0f) / 2 : 0;
+
+        double outerX = radiusX + half;
+        double outerY = radiusY + half;
+        double innerX = radiusX - half;
+        double innerY = radiusY - half;
+        if(outerX <= 0 || outerY <= 0) {
+            return;
+        }
+
+        Area bounds = {{center.x - outerX, center.y - outerY}, 2 * outerX, 2 * outerY};
+        if(drawPoint(bounds, style)) {
+            return;
+        }
+
+        StrokeDashes dashes = strokeDashes(style.penType, 2 * half);
+        OvalArc arc(dashes.isSolid() ? 0 : radiusX, dashes.isSolid() ? 0 : radiusY);
+
+        ClipRect rows = pixelRect(bounds);
+        for(int y = rows.y0; y < rows.y1; y++) {
+            double dy = y + 0.5 - center.y;
+            double outerRatio = 1 - (dy * dy) / (outerY * outerY);
+            if(outerRatio <= 0) {
+                continue;
+            }
+
+            double outerHalf = outerX * std::sqrt(outerRatio);
+            int x0 = pixelEdge(center.x - outerHalf);
+            int x1 = pixelEdge(center.x + outerHalf);
+            auto position = [&arc, &center, dy](int x) {
+                return arc.length(x + 0.5 - center.x, dy);
+            };
+
+            double innerRatio = innerX > 0 && innerY > 0 ? 1 - (dy * dy) / (innerY * innerY) : 0;
+            if(innerRatio <= 0) {
+                if(hasPen) {
+                    addPenSpan(y, x0, x1, dashes, position);
+                }
+                continue;
+            }
+
+            double innerHalf = innerX * std::sqrt(innerRatio);
+            int innerX0 = pixelEdge(center.x - innerHalf);
+            int innerX1 = std::max(innerX0, pixelEdge(center.x + innerHalf));
+            if(hasPen) {
+                addPenSpan(y, x0, innerX0, dashes, position);
+                addPenSpan(y, innerX1, x1, dashes, position);
+            }
+            if(hasBrush) {
+                fillBrushSpan(y, innerX0, innerX1, style);
+            }
+        }
+        if(hasPen) {
+            fillPenSpans(style.penColor);
+        }
     }
 };
 
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*!
+\brief Векторизованные ядра заливки горизонтальных отрезков пикселей
+
+Используются художником для заливки строк холста. При сборке с AVX2 за одну инструкцию
+записывается 8 пикселей, с SSE2 - 4 пикселя, в остальных случаях используется скалярный цикл.
+Штриховки заливаются по маске: бит маски отвечает за пиксель, маска повторяется каждые 8 пикселей.
+Полупрозрачные цвета накладываются правилом source-over: старший байт пикселя - альфа, цветовые
+каналы хранятся умноженными на альфу
+*/
+namespace GUI::Simd {
+
+/*!
+Заполняет непрерывный отрезок пикселей одним цветом
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет заливки
+\return <i>void</i>
+*/
+inline void fillSpan(uint32_t* dst, size_t count, uint32_t color) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+    for(; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 24), value);
+    }
+    for(; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), value);
+    }
+#elif defined(__SSE2__)
+    const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+    for(; i + 16 <= count; i += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), value);
+    }
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+    }
+#endif
+
+    for(; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+
+/*!
+Заполняет пиксели отрезка, выбранные периодической маской, отдельными записями с шагом 8 пикселей для каждого
+бита маски. Для редких масок это дешевле записи всех пикселей, а прежние пиксели не читаются
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет заливки
+\param mask маска из 8 бит
+\return <i>void</i>
+*/
+inline void fillSpanStrided(uint32_t* dst, size_t count, uint32_t color, uint8_t mask) {
+    for(size_t bit = 0; bit < 8 && bit < count; bit++) {
+        if(mask & (1u << bit)) {
+            for(size_t i = bit; i < count; i += 8) {
+                dst[i] = color;
+            }
+        }
+    }
+}
+
+/*!
+Заполняет пиксели отрезка, выбранные периодической маской, остальные пиксели не изменяются.
+Бит i маски отвечает за пиксели с номерами i, i + 8, i + 16 и так далее. С AVX2 используется запись по маске,
+включая остаток отрезка. В SSE2 записи по маске нет: редкие маски заливаются отдельными записями, остальные -
+смешиванием с прежними пикселями
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет заливки
+\param mask маска из 8 бит
+\return <i>void</i>
+*/
+inline void fillSpanMasked(uint32_t* dst, size_t count, uint32_t color, uint8_t mask) {
+#if defined(__AVX2__)
+    size_t i = 0;
+    const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i lanes = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bits), bits);
+    for(; i + 8 <= count; i += 8) {
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + i), lanes, value);
+    }
+    if(i < count) {
+        const __m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count - i)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + i), _mm256_and_si256(lanes, tail), value);
+    }
+#elif defined(__SSE2__)
+    static const uint8_t bitCount[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    if(bitCount[mask & 0xF] + bitCount[mask >> 4] <= 2) {
+        fillSpanStrided(dst, count, color, mask);
+        return;
+    }
+
+    size_t i = 0;
+    const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+    const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i low = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask & 0xF), bits), bits);
+    const __m128i high = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask >> 4), bits), bits);
+    const __m128i lowValue = _mm_and_si128(low, value);
+    const __m128i highValue = _mm_and_si128(high, value);
+    for(; i + 8 <= count; i += 8) {
+        __m128i* first = reinterpret_cast<__m128i*>(dst + i);
+        __m128i* second = reinterpret_cast<__m128i*>(dst + i + 4);
+        _mm_storeu_si128(first, _mm_or_si128(lowValue, _mm_andnot_si128(low, _mm_loadu_si128(first))));
+        _mm_storeu_si128(second, _mm_or_si128(highValue, _mm_andnot_si128(high, _mm_loadu_si128(second))));
+    }
+    if(i + 4 <= count) {
+        __m128i* first = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(first, _mm_or_si128(lowValue, _mm_andnot_si128(low, _mm_loadu_si128(first))));
+        i += 4;
+    }
+
+    for(; i < count; i++) {
+        uint32_t selected = 0u - ((uint32_t(mask) >> (i & 7)) & 1u);
+        dst[i] = (color & selected) | (dst[i] & ~selected);
+    }
+#else
+    fillSpanStrided(dst, count, color, mask);
+#endif
+}
+
+/*!
+Делит на 255 с округлением каждое 16-битное поле, значения полей не больше 255 * 255
+\param value два поля в битах 0-15 и 16-31
+\return <i>uint32_t</i>
+*/
+inline uint32_t divide255(uint32_t value) {
+    value += 0x00800080u;
+    return ((value + ((value >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+}
+
+/*!
+Умножает цветовые каналы цвета на его альфу
+\param color цвет, старший байт - альфа
+\return <i>uint32_t</i> цвет с каналами, умноженными на альфу
+*/
+inline uint32_t premultiply(uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if(alpha == 255) {
+        return color;
+    }
+
+    uint32_t redBlue = divide255((color & 0x00FF00FFu) * alpha);
+    uint32_t green = divide255(((color >> 8) & 0xFFu) * alpha);
+    return (alpha << 24) | (green << 8) | redBlue;
+}
+
+/*!
+Накладывает цвет на пиксель: <i>color + dst * (255 - alpha) / 255</i> для каждого канала
+\param dst прежний пиксель
+\param color цвет, умноженный на альфу
+\return <i>uint32_t</i>
+*/
+inline uint32_t blendPixel(uint32_t dst, uint32_t color) {
+    uint32_t inverse = 255 - (color >> 24);
+    uint32_t redBlue = divide255((dst & 0x00FF00FFu) * inverse);
+    uint32_t alphaGreen = divide255(((dst >> 8) & 0x00FF00FFu) * inverse);
+    return color + ((alphaGreen << 8) | redBlue);
+}
+
+#if defined(__AVX2__)
+/*!
+Накладывает цвет на 8 пикселей
+\param dst прежние пиксели
+\param color цвет, умноженный на альфу, в каждом пикселе
+\param inverse <i>255 - alpha</i> в каждом 16-битном поле
+\return <i>__m256i</i>
+*/
+inline __m256i blendPixels(__m256i dst, __m256i color, __m256i inverse) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(dst, zero), inverse), bias);
+    __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(dst, zero), inverse), bias);
+    low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+    high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+    return _mm256_add_epi8(_mm256_packus_epi16(low, high), color);
+}
+#elif defined(__SSE2__)
+/*!
+Накладывает цвет на 4 пикселя
+\param dst прежние пиксели
+\param color цвет, умноженный на альфу, в каждом пикселе
+\param inverse <i>255 - alpha</i> в каждом 16-битном поле
+\return <i>__m128i</i>
+*/
+inline __m128i blendPixels(__m128i dst, __m128i color, __m128i inverse) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inverse), bias);
+    __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inverse), bias);
+    low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+    return _mm_add_epi8(_mm_packus_epi16(low, high), color);
+}
+#endif
+
+/*!
+Накладывает цвет на непрерывный отрезок пикселей
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет, умноженный на альфу
+\return <i>void</i>
+*/
+inline void blendSpan(uint32_t* dst, size_t count, uint32_t color) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+    const __m256i inverse = _mm256_set1_epi16(static_cast<short>(255 - (color >> 24)));
+    for(; i + 16 <= count; i += 16) {
+        __m256i* first = reinterpret_cast<__m256i*>(dst + i);
+        __m256i* second = reinterpret_cast<__m256i*>(dst + i + 8);
+        _mm256_storeu_si256(first, blendPixels(_mm256_loadu_si256(first), value, inverse));
+        _mm256_storeu_si256(second, blendPixels(_mm256_loadu_si256(second), value, inverse));
+    }
+    for(; i + 8 <= count; i += 8) {
+        __m256i* pixels = reinterpret_cast<__m256i*>(dst + i);
+        _mm256_storeu_si256(pixels, blendPixels(_mm256_loadu_si256(pixels), value, inverse));
+    }
+#elif defined(__SSE2__)
+    const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+    const __m128i inverse = _mm_set1_epi16(static_cast<short>(255 - (color >> 24)));
+    for(; i + 8 <= count; i += 8) {
+        __m128i* first = reinterpret_cast<__m128i*>(dst + i);
+        __m128i* second = reinterpret_cast<__m128i*>(dst + i + 4);
+        _mm_storeu_si128(first, blendPixels(_mm_loadu_si128(first), value, inverse));
+        _mm_storeu_si128(second, blendPixels(_mm_loadu_si128(second), value, inverse));
+    }
+    for(; i + 4 <= count; i += 4) {
+        __m128i* pixels = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(pixels, blendPixels(_mm_loadu_si128(pixels), value, inverse));
+    }
+#endif
+
+    for(; i < count; i++) {
+        dst[i] = blendPixel(dst[i], color);
+    }
+}
+
+/*!
+Накладывает цвет на пиксели отрезка, выбранные периодической маской, как <i>fillSpanMasked</i>. С AVX2 выбранные пиксели
+читаются и записываются по маске. В SSE2 записи по маске нет: цвет накладывается на все пиксели, а невыбранные пиксели
+сохраняют прежнее значение
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет, умноженный на альфу
+\param mask маска из 8 бит
+\return <i>void</i>
+*/
+inline void blendSpanMasked(uint32_t* dst, size_t count, uint32_t color, uint8_t mask) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+    const __m256i inverse = _mm256_set1_epi16(static_cast<short>(255 - (color >> 24)));
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i lanes = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bits), bits);
+    for(; i + 8 <= count; i += 8) {
+        int* pixels = reinterpret_cast<int*>(dst + i);
+        _mm256_maskstore_epi32(pixels, lanes, blendPixels(_mm256_maskload_epi32(pixels, lanes), value, inverse));
+    }
+#elif defined(__SSE2__)
+    const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+    const __m128i inverse = _mm_set1_epi16(static_cast<short>(255 - (color >> 24)));
+    const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i low = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask & 0xF), bits), bits);
+    const __m128i high = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask >> 4), bits), bits);
+    for(; i + 8 <= count; i += 8) {
+        __m128i* first = reinterpret_cast<__m128i*>(dst + i);
+        __m128i* second = reinterpret_cast<__m128i*>(dst + i + 4);
+        __m128i firstPixels = _mm_loadu_si128(first);
+        __m128i secondPixels = _mm_loadu_si128(second);
+        _mm_storeu_si128(first, _mm_or_si128(_mm_and_si128(low, blendPixels(firstPixels, value, inverse)), _mm_andnot_si128(low, firstPixels)));
+        _mm_storeu_si128(second, _mm_or_si128(_mm_and_si128(high, blendPixels(secondPixels, value, inverse)), _mm_andnot_si128(high, secondPixels)));
+    }
+#endif
+
+    for(; i < count; i++) {
+        if(mask & (1u << (i & 7))) {
+            dst[i] = blendPixel(dst[i], color);
+        }
+    }
+}
+
+
+/*!
+Накладывает цвет на отрезок пикселей: непрозрачный цвет записывается без чтения холста, прозрачный пропускается
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет, умноженный на альфу
+\return <i>void</i>
+*/
+inline void compositeSpan(uint32_t* dst, size_t count, uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if(alpha == 255) {
+        fillSpan(dst, count, color);
+    }
+    else if(alpha != 0) {
+        blendSpan(dst, count, color);
+    }
+}
+
+/*!
+Накладывает цвет на пиксели отрезка, выбранные периодической маской, как <i>compositeSpan</i>
+\param dst указатель на первый пиксель отрезка
+\param count количество пикселей
+\param color цвет, умноженный на альфу
+\param mask маска из 8 бит
+\return <i>void</i>
+*/
+inline void compositeSpanMasked(uint32_t* dst, size_t count, uint32_t color, uint8_t mask) {
+    uint32_t alpha = color >> 24;
+    if(alpha == 255) {
+        fillSpanMasked(dst, count, color, mask);
+    }
+    else if(alpha != 0) {
+        blendSpanMasked(dst, count, color, mask);
+    }
+}
+
+}
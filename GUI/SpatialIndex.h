@@ -0,0 +1,569 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+#include <algorithm>
+#include <cmath>
+
+#include "Painter.h"
+
+namespace GUI {
+
+/*!
+\brief Пространственный индекс областей графических примитивов
+
+Равномерная хеш-сетка квадратных ячеек. Каждая ячейка хранит отсортированный список идентификаторов фигур, области которых ее задевают.
+Идентификаторы выдаются по возрастанию в порядке добавления, поэтому порядок идентификаторов совпадает с порядком отрисовки (z-order).
+Фигуры, задевающие слишком много ячеек, хранятся в отдельном списке и проверяются при каждом запросе.
+
+Для отрисовки при сильном уменьшении индекс хранит пирамиду грубых представлений ячеек: на нулевом уровне для каждой непустой ячейки
+запоминаются самая верхняя фигура и ее цвет, каждый следующий уровень объединяет по 2x2 ячейки предыдущего. Ячейки уровня хранятся
+блоками 8x8, чтобы обход области не искал каждую ячейку в хеш-таблице. Изменения только запоминают затронутые ячейки,
+пирамида пересчитывается по ним вызовом <i>refreshAggregates()</i>. Крупные фигуры в пирамиду не входят
+*/
+class SpatialIndex {
+public:
+    static constexpr size_t NotFound = size_t(-1); ///< результат поиска, когда подходящей фигуры нет
+    static constexpr size_t AggregateLevels = 16;  ///< количество уровней пирамиды грубых представлений
+
+private:
+    static constexpr size_t MaxCellsPerFigure = 64; ///< предел ячеек, после которого фигура считается крупной
+    static constexpr size_t MaxMergedCells = 16;    ///< предел ячеек, списки которых сливаются при поиске верхней фигуры
+
+    /// Проиндексированная фигура
+    struct Entry {
+        Area bounds;
+        uint32_t color = 0;
+    };
+
+    /// Грубое представление ячейки: самая верхняя фигура и ее цвет
+    struct Aggregate {
+        size_t id = 0;
+        uint32_t color = 0;
+    };
+
+    static constexpr int32_t BrickBits = 3; ///< грубые представления хранятся блоками 8x8 ячеек одного уровня
+
+    /// Блок грубых представлений, маска отмечает непустые ячейки
+    struct Brick {
+        std::array<Aggregate, 1 << (2 * BrickBits)> cells;
+        uint64_t mask = 0;
+    };
+
+    double m_cellSize;
+    std::pmr::unordered_map<uint64_t, std::pmr::vector<size_t>> m_cells;
+    std::pmr::unordered_map<size_t, Entry> m_entries;
+    std::pmr::vector<size_t> m_largeFigures;
+    std::pmr::vector<std::pmr::unordered_map<uint64_t, Brick>> m_aggregates;
+    std::pmr::vector<uint64_t> m_staleCells;
+    bool m_aggregatesStale = false;
+
+public:
+    explicit SpatialIndex(double cellSize = 64, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        m_cellSize(cellSize),
+        m_cells(resource),
+        m_entries(resource),
+        m_largeFigures(resource),
+        m_aggregates(AggregateLevels, resource),
+        m_staleCells(resource)
+    {
+
+    }
+
+/*!
+Возвращает размер стороны ячейки
+\return <i>double</i>
+*/
+    double cellSize() const {
+        return m_cellSize;
+    }
+
+/*!
+Возвращает количество фигур в индексе
+\return <i>size_t</i>
+*/
+    size_t count() const {
+        return m_entries.size();
+    }
+
+/*!
+Возвращает <i>true</i>, если фигура с такой областью хранится в списке крупных фигур, а не в ячейках
+\param area область фигуры
+\return <i>bool</i>
+*/
+    bool isLarge(const Area& area) const {
+        return cellCount(area) > MaxCellsPerFigure;
+    }
+
+/*!
+Добавляет фигуру в индекс, пустые области не индексируются
+\param id идентификатор фигуры
+\param area область фигуры
+\param color цвет, которым фигура представлена в грубом представлении ячеек
+\return <i>void</i>
+*/
+    void insert(size_t id, const Area& area, uint32_t color = 0) {
+        if(area.isEmpty()) {
+            return;
+        }
+
+        m_entries[id] = {area, color};
+        if(isLarge(area)) {
+            insertSorted(m_largeFigures, id);
+            return;
+        }
+
+        forEachCell(area, [this, id](uint64_t key) {
+            insertSorted(m_cells[key], id);
+            markStale(key);
+        });
+    }
+
+/*!
+Удаляет фигуру из индекса
+\param id идентификатор фигуры
+\return <i>void</i>
+*/
+    void remove(size_t id) {
+        auto entryItr = m_entries.find(id);
+        if(entryItr == m_entries.end()) {
+            return;
+        }
+
+        Area area = entryItr->second.bounds;
+        m_entries.erase(entryItr);
+        if(isLarge(area)) {
+            eraseSorted(m_largeFigures, id);
+            return;
+        }
+
+        forEachCell(area, [this, id](uint64_t key) {
+            auto cellItr = m_cells.find(key);
+            if(cellItr == m_cells.end()) {
+                return;
+            }
+
+            eraseSorted(cellItr->second, id);
+            if(cellItr->second.empty()) {
+                m_cells.erase(cellItr);
+            }
+            markStale(key);
+        });
+    }
+
+/*!
+Возвращает область фигуры, пустую область если фигура не проиндексирована
+\param id идентификатор фигуры
+\return <i>Area</i>
+*/
+    Area bounds(size_t id) const {
+        auto entryItr = m_entries.find(id);
+        return entryItr == m_entries.end() ? Area() : entryItr->second.bounds;
+    }
+
+/*!
+Возвращает идентификаторы фигур, области которых пересекают указанную область, в порядке возрастания (z-order)
+\param area область запроса
+\return <i>std::vector<size_t></i>
+*/
+    std::vector<size_t> query(const Area& area) const {
+        std::vector<size_t> result;
+        if(area.isEmpty()) {
+            return result;
+        }
+
+        auto collect = [this, &area, &result](const std::pmr::vector<size_t>& ids) {
+            for(auto id : ids) {
+                if(m_entries.at(id).bounds.intersects(area)) {
+                    result.push_back(id);
+                }
+            }
+        };
+
+        collect(m_largeFigures);
+        if(cellCount(area) > m_cells.size()) {
+            for(const auto& cell : m_cells) {
+                collect(cell.second);
+            }
+        }
+        else {
+            forEachCell(area, [this, &collect](uint64_t key) {
+                auto cellItr = m_cells.find(key);
+                if(cellItr != m_cells.end()) {
+                    collect(cellItr->second);
+                }
+            });
+        }
+
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+/*!
+Возвращает идентификатор самой верхней фигуры, область которой пересекает указанную область и которую принимает предикат.
+Отсортированные списки задетых ячеек сливаются от больших идентификаторов к меньшим, поэтому обход останавливается
+на первой принятой фигуре и не собирает остальных кандидатов
+\param area область запроса
+\param predicate предикат от идентификатора фигуры
+\return <i>size_t</i> идентификатор фигуры, <i>NotFound</i> если подходящей фигуры нет
+*/
+    template<typename Predicate>
+    size_t findTopmost(const Area& area, Predicate predicate) const {
+        if(area.isEmpty()) {
+            return NotFound;
+        }
+
+        if(cellCount(area) > MaxMergedCells) {
+            auto ids = query(area);
+            auto idItr = std::find_if(ids.rbegin(), ids.rend(), predicate);
+            return idItr == ids.rend() ? NotFound : *idItr;
+        }
+
+        std::pair<const size_t*, const size_t*> lists[MaxMergedCells + 1];
+        size_t listCount = 0;
+        lists[listCount++] = {m_largeFigures.data(), m_largeFigures.data() + m_largeFigures.size()};
+        forEachCell(area, [this, &lists, &listCount](uint64_t key) {
+            auto cellItr = m_cells.find(key);
+            if(cellItr != m_cells.end()) {
+                lists[listCount++] = {cellItr->second.data(), cellItr->second.data() + cellItr->second.size()};
+            }
+        });
+
+        for(;;) {
+            size_t id = NotFound;
+            for(size_t i = 0; i < listCount; i++) {
+                if(lists[i].first != lists[i].second && (id == NotFound || lists[i].second[-1] > id)) {
+                    id = lists[i].second[-1];
+                }
+            }
+            if(id == NotFound) {
+                return NotFound;
+            }
+
+            for(size_t i = 0; i < listCount; i++) {
+                if(lists[i].first != lists[i].second && lists[i].second[-1] == id) {
+                    --lists[i].second;
+                }
+            }
+            if(m_entries.at(id).bounds.intersects(area) && predicate(id)) {
+                return id;
+            }
+        }
+    }
+
+/*!
+Возвращает идентификаторы крупных фигур, области которых пересекают указанную область, в порядке возрастания (z-order)
+\param area область запроса
+\return <i>std::vector<size_t></i>
+*/
+    std::vector<size_t> queryLarge(const Area& area) const {
+        std::vector<size_t> result;
+        for(auto id : m_largeFigures) {
+            if(m_entries.at(id).bounds.intersects(area)) {
+                result.push_back(id);
+            }
+        }
+        return result;
+    }
+
+/*!
+Пересчитывает пирамиду грубых представлений по ячейкам, измененным с прошлого пересчета. Если изменено больше ячеек,
+чем их есть в индексе, пирамида строится заново. Вызывается перед <i>forEachAggregate</i>, параллельно с ним не вызывается
+\return <i>void</i>
+*/
+    void refreshAggregates() {
+        std::pmr::vector<uint64_t> keys(m_staleCells.get_allocator());
+        if(m_aggregatesStale) {
+            for(auto& level : m_aggregates) {
+                level.clear();
+            }
+            keys.reserve(m_cells.size());
+            for(const auto& cell : m_cells) {
+                keys.push_back(cell.first);
+            }
+        }
+        else {
+            keys.swap(m_staleCells);
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        }
+        m_staleCells.clear();
+        m_aggregatesStale = false;
+
+        for(auto key : keys) {
+            auto cellItr = m_cells.find(key);
+            if(cellItr == m_cells.end()) {
+                setAggregate(0, cellX(key), cellY(key), nullptr);
+                continue;
+            }
+
+            Aggregate aggregate = {cellItr->second.back(), m_entries.at(cellItr->second.back()).color};
+            setAggregate(0, cellX(key), cellY(key), &aggregate);
+        }
+
+        for(size_t level = 1; level < AggregateLevels && !keys.empty(); level++) {
+            for(auto& key : keys) {
+                key = cellKey(cellX(key) >> 1, cellY(key) >> 1);
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+            for(auto key : keys) {
+                const Aggregate* top = nullptr;
+                for(int32_t child = 0; child < 4; child++) {
+                    auto aggregate = aggregateAt(level - 1, 2 * cellX(key) + (child & 1), 2 * cellY(key) + (child >> 1));
+                    if(aggregate && (!top || aggregate->id > top->id)) {
+                        top = aggregate;
+                    }
+                }
+                setAggregate(level, cellX(key), cellY(key), top);
+            }
+        }
+    }
+
+/*!
+Вызывает функцию для каждой непустой ячейки пирамиды, задевающей область. Берется нижний уровень, ячейки которого
+не меньше указанного размера, поэтому количество вызовов ограничено площадью области, а не количеством фигур
+\param area область запроса
+\param minCellSize наименьший размер ячейки
+\param function вызываемый объект с параметрами (область ячейки, цвет верхней фигуры)
+\return <i>void</i>
+*/
+    template<typename Function>
+    void forEachAggregate(const Area& area, double minCellSize, Function function) const {
+        if(area.isEmpty()) {
+            return;
+        }
+
+        size_t level = aggregateLevel(minCellSize);
+        double size = std::ldexp(m_cellSize, int(level));
+        auto cellAt = [size](double coordinate) {
+            return int32_t(std::clamp(std::floor(coordinate / size), -2.0e9, 2.0e9));
+        };
+        int32_t x0 = cellAt(area.corner.x);
+        int32_t y0 = cellAt(area.corner.y);
+        int32_t x1 = cellAt(std::nextafter(area.right(), area.corner.x));
+        int32_t y1 = cellAt(std::nextafter(area.bottom(), area.corner.y));
+        auto visit = [x0, y0, x1, y1, size, &function](uint64_t key, const Brick& brick) {
+            for(int32_t slot = 0; slot < int32_t(brick.cells.size()); slot++) {
+                int32_t x = cellX(key) * (1 << BrickBits) + (slot & ((1 << BrickBits) - 1));
+                int32_t y = cellY(key) * (1 << BrickBits) + (slot >> BrickBits);
+                if(((brick.mask >> slot) & 1) && x >= x0 && x <= x1 && y >= y0 && y <= y1) {
+                    function(Area({x * size, y * size}, size, size), brick.cells[size_t(slot)].color);
+                }
+            }
+        };
+
+        const auto& bricks = m_aggregates[level];
+        int32_t brickX0 = x0 >> BrickBits;
+        int32_t brickY0 = y0 >> BrickBits;
+        int32_t brickX1 = x1 >> BrickBits;
+        int32_t brickY1 = y1 >> BrickBits;
+        if(double(brickX1 - brickX0 + 1) * double(brickY1 - brickY0 + 1) > double(bricks.size())) {
+            for(const auto& brick : bricks) {
+                visit(brick.first, brick.second);
+            }
+            return;
+        }
+
+        for(int32_t y = brickY0; y <= brickY1; y++) {
+            for(int32_t x = brickX0; x <= brickX1; x++) {
+                auto brickItr = bricks.find(cellKey(x, y));
+                if(brickItr != bricks.end()) {
+                    visit(brickItr->first, brickItr->second);
+                }
+            }
+        }
+    }
+
+/*!
+Возвращает область, расширенную до границ ячеек пирамиды того уровня, который <i>forEachAggregate</i> берет для указанного размера.
+Изменение фигуры меняет грубое представление всех ячеек этой области
+\param area область
+\param minCellSize наименьший размер ячейки
+\return <i>Area</i>
+*/
+    Area aggregateArea(const Area& area, double minCellSize) const {
+        if(area.isEmpty()) {
+            return {};
+        }
+
+        double size = std::ldexp(m_cellSize, int(aggregateLevel(minCellSize)));
+        double x0 = std::floor(area.corner.x / size) * size;
+        double y0 = std::floor(area.corner.y / size) * size;
+        double x1 = std::ceil(area.right() / size) * size;
+        double y1 = std::ceil(area.bottom() / size) * size;
+        return {{x0, y0}, x1 - x0, y1 - y0};
+    }
+
+/*!
+Удаляет все фигуры из индекса
+\return <i>void</i>
+*/
+    void clear() {
+        m_cells.clear();
+        m_entries.clear();
+        m_largeFigures.clear();
+        for(auto& level : m_aggregates) {
+            level.clear();
+        }
+        m_staleCells.clear();
+        m_aggregatesStale = false;
+    }
+
+private:
+/*!
+Возвращает номер ячейки, в которую попадает координата
+\param coordinate координата
+\return <i>int32_t</i>
+*/
+    int32_t cellOf(double coordinate) const {
+        return int32_t(std::clamp(std::floor(coordinate / m_cellSize), -2.0e9, 2.0e9));
+    }
+
+/*!
+Возвращает ключ ячейки в хеш-таблице
+\param x номер ячейки по оси x
+\param y номер ячейки по оси y
+\return <i>uint64_t</i>
+*/
+    static uint64_t cellKey(int32_t x, int32_t y) {
+        return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+    }
+
+/*!
+Возвращает нижний уровень пирамиды, ячейки которого не меньше указанного размера
+\param minCellSize наименьший размер ячейки
+\return <i>size_t</i>
+*/
+    size_t aggregateLevel(double minCellSize) const {
+        size_t level = 0;
+        for(double size = m_cellSize; size < minCellSize && level + 1 < AggregateLevels; size *= 2) {
+            level++;
+        }
+        return level;
+    }
+
+/*!
+Возвращает грубое представление ячейки уровня пирамиды, <i>nullptr</i> для пустой ячейки
+\param level уровень пирамиды
+\param x номер ячейки по оси x
+\param y номер ячейки по оси y
+\return <i>const Aggregate*</i>
+*/
+    const Aggregate* aggregateAt(size_t level, int32_t x, int32_t y) const {
+        auto brickItr = m_aggregates[level].find(cellKey(x >> BrickBits, y >> BrickBits));
+        if(brickItr == m_aggregates[level].end()) {
+            return nullptr;
+        }
+
+        size_t slot = size_t(((y & ((1 << BrickBits) - 1)) << BrickBits) | (x & ((1 << BrickBits) - 1)));
+        return (brickItr->second.mask >> slot) & 1 ? &brickItr->second.cells[slot] : nullptr;
+    }
+
+/*!
+Записывает грубое представление ячейки уровня пирамиды, пустой блок удаляется
+\param level уровень пирамиды
+\param x номер ячейки по оси x
+\param y номер ячейки по оси y
+\param aggregate грубое представление, <i>nullptr</i> для пустой ячейки
+\return <i>void</i>
+*/
+    void setAggregate(size_t level, int32_t x, int32_t y, const Aggregate* aggregate) {
+        uint64_t key = cellKey(x >> BrickBits, y >> BrickBits);
+        size_t slot = size_t(((y & ((1 << BrickBits) - 1)) << BrickBits) | (x & ((1 << BrickBits) - 1)));
+        if(aggregate) {
+            auto& brick = m_aggregates[level][key];
+            brick.cells[slot] = *aggregate;
+            brick.mask |= uint64_t(1) << slot;
+            return;
+        }
+
+        auto brickItr = m_aggregates[level].find(key);
+        if(brickItr != m_aggregates[level].end()) {
+            brickItr->second.mask &= ~(uint64_t(1) << slot);
+            if(brickItr->second.mask == 0) {
+                m_aggregates[level].erase(brickItr);
+            }
+        }
+    }
+
+    static int32_t cellX(uint64_t key) {
+        return int32_t(uint32_t(key >> 32));
+    }
+
+    static int32_t cellY(uint64_t key) {
+        return int32_t(uint32_t(key));
+    }
+
+/*!
+Запоминает ячейку, грубое представление которой нужно пересчитать. Когда запомненных ячеек больше, чем ячеек в индексе,
+список заменяется признаком полного пересчета, поэтому его размер ограничен
+\param key ключ ячейки
+\return <i>void</i>
+*/
+    void markStale(uint64_t key) {
+        if(m_aggregatesStale) {
+            return;
+        }
+
+        if(m_staleCells.size() >= std::max<size_t>(m_cells.size(), 1024)) {
+            m_staleCells.clear();
+            m_aggregatesStale = true;
+            return;
+        }
+        m_staleCells.push_back(key);
+    }
+
+/*!
+Возвращает количество ячеек, которые задевает область
+\param area область
+\return <i>size_t</i>
+*/
+    size_t cellCount(const Area& area) const {
+        size_t columns = size_t(int64_t(cellOf(std::nextafter(area.right(), area.corner.x))) - cellOf(area.corner.x) + 1);
+        size_t rows = size_t(int64_t(cellOf(std::nextafter(area.bottom(), area.corner.y))) - cellOf(area.corner.y) + 1);
+        return columns * rows;
+    }
+
+/*!
+Вызывает функцию для ключа каждой ячейки, которую задевает область
+\param area область
+\param function вызываемый объект
+\return <i>void</i>
+*/
+    template<typename Function>
+    void forEachCell(const Area& area, Function function) const {
+        int32_t x0 = cellOf(area.corner.x);
+        int32_t y0 = cellOf(area.corner.y);
+        int32_t x1 = cellOf(std::nextafter(area.right(), area.corner.x));
+        int32_t y1 = cellOf(std::nextafter(area.bottom(), area.corner.y));
+
+        for(int32_t y = y0; y <= y1; y++) {
+            for(int32_t x = x0; x <= x1; x++) {
+                function(cellKey(x, y));
+            }
+        }
+    }
+
+    static void insertSorted(std::pmr::vector<size_t>& ids, size_t id) {
+        if(ids.empty() || ids.back() < id) {
+            ids.push_back(id);
+            return;
+        }
+
+        ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+    }
+
+    static void eraseSorted(std::pmr::vector<size_t>& ids, size_t id) {
+        auto idItr = std::lower_bound(ids.begin(), ids.end(), id);
+        if(idItr != ids.end() && *idItr == id) {
+            ids.erase(idItr);
+        }
+    }
+};
+
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "GraphicPrimitives/GraphicPrimitives.h"
+
+/*!
+\brief Шаблоны пунктира и буфер отрезков строк для обводки контуров
+
+Художник переводит контур фигуры в отрезки строк пикселей и собирает их в буфер, который затем заливается ядрами заливки
+одним проходом. Пунктир задается таблицами штрихов для каждого типа кисти и применяется при сборе отрезков: отрезок строки
+делится только там, где меняется штрих, поэтому пунктирный контур стоит почти столько же, сколько сплошной
+*/
+namespace GUI {
+
+/*!
+\brief Отрезок строки пикселей, правая граница не включается
+*/
+struct Span {
+    int y = 0;
+    int x0 = 0;
+    int x1 = 0;
+};
+
+/*!
+\brief Шаблон кисти с длинами штрихов в пикселях
+
+Чередующиеся штрихи и промежутки, концы хранятся нарастающим итогом. Положение на контуре переводится в номер штриха
+одним делением на период и коротким поиском по таблице, четные номера - штрихи, нечетные - промежутки. Номера периодов
+берутся по модулю <i>TurnWrap</i>, поэтому положения на контуре отрезка, начало которого далеко за холстом, не переполняют номер
+*/
+class StrokeDashes {
+    static constexpr double TurnWrap = double(int64_t(1) << 48); ///< четный, поэтому четность номеров штрихов сохраняется
+
+
+    std::array<double, 4> m_ends = {};
+    size_t m_count = 0;
+    double m_period = 0;
+    double m_frequency = 0;
+
+public:
+    StrokeDashes() {
+
+    }
+
+    StrokeDashes(const std::array<double, 4>& ends, size_t count, double width) : m_count(count) {
+        for(size_t i = 0; i < m_count; i++) {
+            m_ends[i] = ends[i] * width;
+        }
+        if(m_count > 0) {
+            m_period = m_ends[m_count - 1];
+            m_frequency = 1 / m_period;
+        }
+    }
+
+/*!
+Возвращает <i>true</i> для сплошной кисти без промежутков
+\return <i>bool</i>
+*/
+    bool isSolid() const {
+        return m_count == 0;
+    }
+
+/*!
+Возвращает номер штриха или промежутка, в который попадает положение на контуре
+\param position положение на контуре в пикселях
+\return <i>int64_t</i>
+*/
+    int64_t segment(double position) const {
+        double turns = std::floor(position * m_frequency);
+        if(!std::isfinite(turns)) {
+            return 0;
+        }
+
+        double rest = position - turns * m_period;
+        size_t i = 0;
+        while(i + 1 < m_count && rest >= m_ends[i]) {
+            i++;
+        }
+        return int64_t(std::fmod(turns, TurnWrap)) * int64_t(m_count) + int64_t(i);
+    }
+
+/*!
+Возвращает положение на контуре, с которого начинается штрих или промежуток
+\param segment номер штриха или промежутка
+\return <i>double</i>
+*/
+    double start(int64_t segment) const {
+        double turns = std::floor((double(segment) + 0.5) / double(m_count));
+        int64_t i = segment - int64_t(turns) * int64_t(m_count);
+        return turns * m_period + (i == 0 ? 0 : m_ends[size_t(i - 1)]);
+    }
+
+/*!
+Возвращает <i>true</i>, если номер принадлежит штриху, а не промежутку
+\param segment номер штриха или промежутка
+\return <i>bool</i>
+*/
+    static bool isDash(int64_t segment) {
+        return (segment & 1) == 0;
+    }
+};
+
+/*!
+Возвращает шаблон кисти для типа кисти и толщины. Длины штрихов заданы в толщинах кисти:
+штрих 4 и промежуток 2 для пунктира, точка 1 и промежуток 2 для точечной линии
+\param type тип кисти
+\param width толщина кисти в пикселях
+\return <i>StrokeDashes</i>
+*/
+inline StrokeDashes strokeDashes(GraphicPrimitive::PenType type, double width) {
+    struct Pattern {
+        std::array<double, 4> ends;
+        size_t count;
+    };
+    static const Pattern patterns[] = {
+        {{}, 0},     // None
+        {{}, 0},     // Solid
+        {{4, 6}, 2}, // Dash
+        {{1, 3}, 2}  // Dot
+    };
+    const Pattern& pattern = patterns[size_t(type)];
+    return {pattern.ends, pattern.count, width};
+}
+
+/*!
+\brief Длина дуги эллипса до точки
+
+Положение точки на контуре задается длиной дуги средней линии контура до ее параметрического угла. Вместо угла
+используется псевдоугол <i>|y| / (|x| + |y|)</i> в нормированных координатах: он монотонен в каждой четверти
+и вычисляется одним делением. Длина дуги первой четверти заранее сведена в таблицу по сетке псевдоугла, остальные
+четверти симметричны. Таблица строится только для пунктира
+*/
+class OvalArc {
+    static constexpr size_t Steps = 64;
+
+    /// Параметрический угол, его синус и косинус в узлах сетки псевдоугла первой четверти
+    struct Grid {
+        std::array<double, Steps + 1> angle;
+        std::array<double, Steps + 1> sin;
+        std::array<double, Steps + 1> cos;
+    };
+
+    double m_scaleX = 0;
+    double m_scaleY = 0;
+    std::array<double, Steps + 1> m_lengths = {};
+
+public:
+/*!
+Строит таблицу длин дуги. Нулевые радиусы означают, что длины дуги не понадобятся
+\param radiusX радиус по оси x
+\param radiusY радиус по оси y
+*/
+    OvalArc(double radiusX, double radiusY) {
+        if(radiusX <= 0 || radiusY <= 0) {
+            return;
+        }
+
+        m_scaleX = 1 / radiusX;
+        m_scaleY = 1 / radiusY;
+        const Grid& nodes = grid();
+        double previous = radiusY;
+        for(size_t i = 1; i <= Steps; i++) {
+            if(radiusX == radiusY) {
+                m_lengths[i] = radiusX * nodes.angle[i];
+                continue;
+            }
+
+            double x = radiusX * nodes.sin[i];
+            double y = radiusY * nodes.cos[i];
+            double current = std::sqrt(x * x + y * y);
+            m_lengths[i] = m_lengths[i - 1] + (previous + current) / 2 * (nodes.angle[i] - nodes.angle[i - 1]);
+            previous = current;
+        }
+    }
+
+/*!
+Возвращает длину дуги от правой точки эллипса по часовой стрелке на экране до точки
+\param dx смещение точки от центра по оси x
+\param dy смещение точки от центра по оси y
+\return <i>double</i>
+*/
+    double length(double dx, double dy) const {
+        double x = dx * m_scaleX;
+        double y = dy * m_scaleY;
+        double sum = std::abs(x) + std::abs(y);
+        if(sum == 0) {
+            return 0;
+        }
+
+        double index = std::abs(y) / sum * Steps;
+        size_t i = std::min(size_t(index), Steps - 1);
+        double partial = m_lengths[i] + (m_lengths[i + 1] - m_lengths[i]) * (index - double(i));
+        double quarter = m_lengths[Steps];
+        if(x >= 0) {
+            return y >= 0 ? partial : 4 * quarter - partial;
+        }
+        return y >= 0 ? 2 * quarter - partial : 2 * quarter + partial;
+    }
+
+private:
+/*!
+Возвращает узлы сетки псевдоугла, они не зависят от радиусов и вычисляются один раз
+\return <i>const Grid&</i>
+*/
+    static const Grid& grid() {
+        static const Grid nodes = [] {
+            Grid result;
+            for(size_t i = 0; i <= Steps; i++) {
+                double pseudo = double(i) / Steps;
+                double norm = std::hypot(pseudo, 1 - pseudo);
+                result.angle[i] = std::atan2(pseudo, 1 - pseudo);
+                result.sin[i] = pseudo / norm;
+                result.cos[i] = (1 - pseudo) / norm;
+            }
+            return result;
+        }();
+        return nodes;
+    }
+};
+
+/*!
+\brief Буфер отрезков строк контура
+
+Смежные отрезки одной строки сливаются. Пунктирный отрезок делится по границам штрихов, которые ищутся пробами
+положения на контуре, поэтому работа растет с количеством границ штрихов на отрезке, а не с его длиной
+*/
+class SpanBuffer {
+    std::vector<Span> m_spans;
+
+public:
+    const std::vector<Span>& spans() const {
+        return m_spans;
+    }
+
+    size_t size() const {
+        return m_spans.size();
+    }
+
+    void clear() {
+        m_spans.clear();
+    }
+
+/*!
+Добавляет отрезок строки
+\param y номер строки
+\param x0 первый пиксель отрезка
+\param x1 пиксель за последним пикселем отрезка
+\return <i>void</i>
+*/
+    void add(int y, int x0, int x1) {
+        if(x0 >= x1) {
+            return;
+        }
+
+        if(!m_spans.empty() && m_spans.back().y == y && m_spans.back().x1 == x0) {
+            m_spans.back().x1 = x1;
+            return;
+        }
+        m_spans.push_back({y, x0, x1});
+    }
+
+/*!
+Добавляет части отрезка строки, попавшие на штрихи шаблона
+\param y номер строки
+\param x0 первый пиксель отрезка
+\param x1 пиксель за последним пикселем отрезка
+\param dashes шаблон кисти
+\param position положение центра пикселя на контуре, монотонное на отрезке
+\return <i>void</i>
+*/
+    template<typename Position>
+    void add(int y, int x0, int x1, const StrokeDashes& dashes, Position position) {
+        if(dashes.isSolid()) {
+            add(y, x0, x1);
+            return;
+        }
+        if(x0 >= x1) {
+            return;
+        }
+
+        double firstPosition = position(x0);
+        int64_t first = dashes.segment(firstPosition);
+        int last = x1 - 1;
+        double lastPosition = x0 == last ? firstPosition : position(last);
+        int64_t lastSegment = x0 == last ? first : dashes.segment(lastPosition);
+        while(first != lastSegment) {
+            int border = findBorder(x0, firstPosition, first, last, lastPosition, dashes, position, firstPosition);
+            if(StrokeDashes::isDash(first)) {
+                add(y, x0, border);
+            }
+            x0 = border;
+            first = dashes.segment(firstPosition);
+        }
+        if(StrokeDashes::isDash(first)) {
+            add(y, x0, x1);
+        }
+    }
+
+/*!
+Повторяет отрезки буфера с номерами [first, last) в другой строке
+\param first номер первого отрезка
+\param last номер за последним отрезком
+\param y номер строки
+\return <i>void</i>
+*/
+    void repeat(size_t first, size_t last, int y) {
+        for(size_t i = first; i < last; i++) {
+            Span span = m_spans[i];
+            m_spans.push_back({y, span.x0, span.x1});
+        }
+    }
+
+private:
+/*!
+Находит первый пиксель после <i>from</i>, попавший на другой штрих или промежуток. Следующая проба берется
+интерполяцией положения к границе штриха, а если она плохо сужает промежуток, то делением пополам. Поэтому граница
+обычно находится за две пробы, а результат совпадает с проверкой каждого пикселя
+\param from пиксель, попавший на штрих <i>segment</i>
+\param fromPosition положение пикселя <i>from</i> на контуре
+\param segment номер штриха или промежутка пикселя <i>from</i>
+\param to пиксель, попавший на другой штрих или промежуток
+\param toPosition положение пикселя <i>to</i> на контуре
+\param dashes шаблон кисти
+\param position положение центра пикселя на контуре
+\param borderPosition положение найденного пикселя на контуре
+\return <i>int</i>
+*/
+    template<typename Position>
+    static int findBorder(int from, double fromPosition, int64_t segment, int to, double toPosition, const StrokeDashes& dashes,
+                          Position& position, double& borderPosition) {
+        double target = dashes.start(toPosition > fromPosition ? segment + 1 : segment);
+        bool bisect = false;
+        while(to - from > 1) {
+            int width = to - from;
+            int x = from + width / 2;
+            if(!bisect && toPosition != fromPosition) {
+                double guess = from + (target - fromPosition) / (toPosition - fromPosition) * width;
+                x = int(std::clamp(std::ceil(guess), double(from + 1), double(to - 1)));
+            }
+
+            double current = position(x);
+            if(dashes.segment(current) == segment) {
+                from = x;
+                fromPosition = current;
+            }
+            else {
+                to = x;
+                toPosition = current;
+            }
+            bisect = !bisect && 2 * (to - from) > width;
+        }
+        borderPosition = toPosition;
+        return to;
+    }
+};
+
+}
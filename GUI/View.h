@@ -1,30 +1,125 @@
 #pragma once
 
 #include "Painter.h"
+#include "HitTest.h"
+#include "SpatialIndex.h"
+#include "DirtyRegion.h"
 #include "GraphicPrimitivesModel/GraphicPrimitivesModel.h"
+#include "Scheduler/JobScheduler.h"
 
 namespace GUI {
 
+/*!
+\brief Статистика кэша плиток представления
+*/
+struct TileCacheStatistics {
+    size_t hits = 0;   ///< плиток, оставшихся на холсте без растеризации при обновлениях
+    size_t misses = 0; ///< плиток, растеризованных заново
+
+/*!
+Возвращает долю попаданий в кэш от 0 до 1
+\return <i>double</i>
+*/
+    double hitRatio() const {
+        return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses);
+    }
+};
+
 /*!
 \brief Класс графического представления геометрических примитивов
 
-Класс, который позволяют отображать графические примитивы, находящиеся в модели. Синхронизируется осуществляется через callback-и
+Класс, который позволяют отображать графические примитивы, находящиеся в модели. Синхронизируется осуществляется через callback-и.
+Вместо модели объект можно связать со снимком модели, тогда изменения вместе с новыми снимками передает владелец представления.
+Каждой отображаемой фигуре выдается идентификатор, области фигур хранятся в пространственном индексе.
+Если установлен планировщик, области больших пакетов фигур для индекса вычисляются параллельно.
+
+Холст разбит на плитки фиксированного размера. Каждая плитка хранит отсортированный список идентификаторов фигур, которые ее задевают,
+и признак устаревания. Холст служит кэшем растеризованных плиток: при удалении фигуры устаревают только задетые ею плитки,
+и только они растеризуются заново, остальные остаются на холсте без изменений. Новые фигуры рисуются поверх прямо на холсте,
+а большие пакеты растеризуются по плиткам. Каждая плитка рисуется своим художником с отсечением по плитке, плитки не пересекаются,
+поэтому рисуются параллельно без синхронизации.
+
+В режиме отложенной перерисовки изменения модели только обновляют индекс и списки плиток и накапливают области в <i>DirtyRegion</i>,
+а вызов <i>flush()</i> один раз перерисовывает объединенные области, сколько бы изменений ни пришло между вызовами.
+
+Фигуры и пространственный индекс хранятся в координатах сцены, холст показывает видимую часть сцены через преобразование
+с масштабом и сдвигом. В списки плиток попадают только фигуры, видимые на холсте: при смене видимой области они строятся заново
+запросом к индексу, поэтому ее стоимость зависит от количества видимых фигур, а не от размера сцены. При сдвиге на целое число
+пикселей без смены масштаба изображение сдвигается на холсте, и растеризуются заново только открывшиеся полосы.
+
+При сильном уменьшении, когда ячейка пространственного индекса занимает на холсте меньше <i>LevelOfDetail::aggregateCellSize</i> пикселей,
+вместо отдельных фигур рисуются грубые представления ячеек индекса размером не меньше пикселя, а в списки плиток попадают только крупные
+фигуры, которые рисуются поверх них. Поэтому время кадра ограничено площадью холста, а не количеством фигур сцены
 */
 class View {
+public:
+    /// Режим растеризации плиток
+    enum class RenderMode {
+        Sequential, ///< плитки рисуются по очереди в вызывающем потоке
+        Tiled       ///< плитки распределяются по рабочим потокам планировщика
+    };
+
+    /// Режим перерисовки при изменении модели
+    enum class RepaintMode {
+        Immediate, ///< изменения отрисовываются сразу в callback-е модели
+        Deferred   ///< изменения накапливаются и отрисовываются вызовом <i>flush()</i>
+    };
+
+    /// Правило выбора фигур областью
+    enum class SelectionMode {
+        Contained,  ///< выбираются фигуры, целиком лежащие в области
+        Intersected ///< выбираются фигуры, задевающие область
+    };
+
+    static constexpr uint32_t TileSize = 128;             ///< сторона плитки в пикселях
+    static constexpr size_t TiledRenderThreshold = 1024; ///< размер пакета добавляемых фигур, начиная с которого задетые плитки растеризуются заново
+
+private:
+    static constexpr size_t BoundsGrain = 4096; ///< количество фигур в одной части параллельного вычисления областей
+
     uint32_t m_width;
     uint32_t m_height;
+    Transform m_transform;
+    LevelOfDetail m_detail;
+    bool m_aggregated = false;
+    int m_patternX = 0; ///< пиксель холста, к которому привязаны узоры заливки, сдвигается вместе с прокруткой холста
+    int m_patternY = 0;
     Painter m_painter;
     std::shared_ptr<Canvas> m_canvas;
-    std::list<Area> m_renderFigureAreas;
+    std::pmr::vector<size_t> m_figureIds;
+    size_t m_nextFigureId = 0;
+    SpatialIndex m_index;
+    Scheduler::JobScheduler* m_scheduler = nullptr;
+    RenderMode m_renderMode = RenderMode::Tiled;
+    RepaintMode m_repaintMode = RepaintMode::Immediate;
+    DirtyRegion m_dirtyRegion;
+
+    uint32_t m_tileColumns = 0;
+    uint32_t m_tileRows = 0;
+    std::pmr::vector<std::pmr::vector<size_t>> m_tiles; ///< идентификаторы фигур каждой плитки в порядке отрисовки
+    std::pmr::vector<Area> m_tileDirtyArea; ///< устаревшая часть каждой плитки, пустая для актуальной плитки
+    std::pmr::vector<uint32_t> m_dirtyTiles;
+    TileCacheStatistics m_tileStatistics;
 
     std::shared_ptr<Model::GraphicPrimitivesModel> m_model;
     size_t m_addConnectedIndex;
     size_t m_removedConnectedIndex;
+    Model::GraphicPrimitivesModel::Snapshot m_snapshot;
+    bool m_snapshotSource = false; ///< графические примитивы читаются из снимка, изменения передает владелец представления
 
 public:
-    View(uint32_t width, uint32_t height) : m_width(width), m_height(height) {
+    View(uint32_t width, uint32_t height, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        m_width(width),
+        m_height(height),
+        m_figureIds(resource),
+        m_index(64, resource),
+        m_tiles(resource),
+        m_tileDirtyArea(resource),
+        m_dirtyTiles(resource)
+    {
         m_canvas = std::make_shared<Canvas>(m_width, m_height);
         m_painter.setCanvas(m_canvas);
+        resetTiles();
     }
 
     ~View() {
@@ -32,7 +127,7 @@ public:
     }
 
  /*!
-Связывает объект с моделью, подключает callback-и
+Связывает объект с моделью, подключает callback-и. Callback-и прежней модели отключаются
 \param model модель
 \return <i>void</i>
 */
@@ -41,101 +136,762 @@ public:
             return;
         }
 
+        resetModel();
         m_model = model;
-        m_addConnectedIndex = m_model->connectToAddFigure([this](size_t index){ addFigure(index); });
-        m_removedConnectedIndex = m_model->connectToRemoveFigure([this](size_t index){ removeFigure(index); });
+        m_addConnectedIndex = m_model->connectToAddFigures([this](size_t first, size_t count){ addFigures(first, count); });
+        m_removedConnectedIndex = m_model->connectToRemoveFigures([this](size_t first, size_t count){ removeFigures(first, count); });
+
+        addFigures(0, m_model->count());
+    }
 
-        for(size_t i = 0; i < m_model->count(); i++) {
-            addFigure(i);
+ /*!
+Связывает объект со снимком модели вместо модели. Callback-и не подключаются: владелец представления сам передает изменения
+модели вызовами <i>addFigures()</i> и <i>removeFigures()</i> вместе со снимком версии после изменения, поэтому представление
+может обновляться в другом потоке, чем писатель модели
+\param snapshot снимок модели
+\return <i>void</i>
+*/
+    void setSnapshot(Model::GraphicPrimitivesModel::Snapshot snapshot) {
+        resetModel();
+        m_snapshot = std::move(snapshot);
+        m_snapshotSource = true;
+        addFigures(0, m_snapshot.count());
+    }
+
+ /*!
+Добавляет отображение диапазона графических примитивов, когда объект связан со снимком
+\param snapshot снимок версии модели, содержащей добавленный диапазон
+\param first индекс первого добавленного графического примитива
+\param count количество добавленных графических примитивов
+\return <i>void</i>
+*/
+    void addFigures(Model::GraphicPrimitivesModel::Snapshot snapshot, size_t first, size_t count) {
+        if(!m_snapshotSource) {
+            return;
         }
+
+        m_snapshot = std::move(snapshot);
+        addFigures(first, count);
     }
 
  /*!
-Отвязывает объект от установленной модели, отключает callback-и
+Удаляет отображение диапазона графических примитивов, когда объект связан со снимком
+\param snapshot снимок версии модели после удаления
+\param first индекс первого удаленного графического примитива
+\param count количество удаленных графических примитивов
+\return <i>void</i>
+*/
+    void removeFigures(Model::GraphicPrimitivesModel::Snapshot snapshot, size_t first, size_t count) {
+        if(!m_snapshotSource) {
+            return;
+        }
+
+        removeFigures(first, count);
+        m_snapshot = std::move(snapshot);
+    }
+
+ /*!
+Отвязывает объект от установленной модели или снимка, отключает callback-и
 \return <i>void</i>
 */
     void resetModel() {
-        if(!m_model) {
+        if(!isBound()) {
             return;
         }
 
-        m_model->disconnectToAddFigure(m_addConnectedIndex);
-        m_model->disconnectToRemoveFigure(m_removedConnectedIndex);
-        m_model.reset();
-        m_renderFigureAreas.clear();
+        if(m_model) {
+            m_model->disconnectToAddFigure(m_addConnectedIndex);
+            m_model->disconnectToRemoveFigure(m_removedConnectedIndex);
+            m_model.reset();
+        }
+        m_snapshot = {};
+        m_snapshotSource = false;
+        m_figureIds.clear();
+        m_index.clear();
+        resetTiles();
+        m_dirtyRegion.clear();
         m_painter.clearAll();
     }
 
+ /*!
+Устанавливает планировщик, на котором выполняется обслуживание индекса. Без планировщика вся работа выполняется в вызывающем потоке
+\param scheduler планировщик задач
+\return <i>void</i>
+*/
+    void setScheduler(Scheduler::JobScheduler* scheduler) {
+        m_scheduler = scheduler;
+    }
+
+ /*!
+Устанавливает режим растеризации плиток. Режим <i>Tiled</i> без планировщика рисует плитки по очереди в вызывающем потоке
+\param renderMode режим перерисовки
+\return <i>void</i>
+*/
+    void setRenderMode(RenderMode renderMode) {
+        m_renderMode = renderMode;
+    }
+
+    RenderMode renderMode() const {
+        return m_renderMode;
+    }
+
+ /*!
+Устанавливает режим перерисовки при изменении модели. При переходе в немедленный режим накопленные изменения отрисовываются
+\param repaintMode режим перерисовки
+\return <i>void</i>
+*/
+    void setRepaintMode(RepaintMode repaintMode) {
+        m_repaintMode = repaintMode;
+        if(m_repaintMode == RepaintMode::Immediate) {
+            flush();
+        }
+    }
+
+    RepaintMode repaintMode() const {
+        return m_repaintMode;
+    }
+
+ /*!
+Возвращает <i>true</i>, если есть изменения, ожидающие перерисовки
+\return <i>bool</i>
+*/
+    bool hasPendingRepaint() const {
+        return !m_dirtyRegion.isEmpty();
+    }
+
+ /*!
+Перерисовывает накопленные области один раз: части плиток, которые задевают объединенные области, растеризуются заново.
+Вызывается на каждом кадре в режиме отложенной перерисовки
+\return <i>Area</i> область, которая была перерисована
+*/
+    Area flush() {
+        if(m_dirtyRegion.isEmpty()) {
+            return {};
+        }
+
+        for(const auto& rect : m_dirtyRegion.rects()) {
+            forEachTile(rect, [this, &rect](uint32_t tile, uint32_t, uint32_t) {
+                markTileDirty(tile, rect);
+            });
+        }
+
+        Area repainted = m_dirtyRegion.bounds();
+        m_dirtyRegion.clear();
+        updateTiles();
+        return repainted;
+    }
+
+ /*!
+Возвращает холст представления
+\return <i>std::shared_ptr<Canvas></i>
+*/
+    std::shared_ptr<Canvas> canvas() const {
+        return m_canvas;
+    }
+
+ /*!
+Возвращает статистику кэша плиток: сколько раз плитки оставались на холсте и сколько раз растеризовались заново
+\return <i>TileCacheStatistics</i>
+*/
+    TileCacheStatistics tileCacheStatistics() const {
+        return m_tileStatistics;
+    }
+
+ /*!
+Изменяет размеры холста и полностью перерисовывает его
+\param width ширина холста
+\param height высота холста
+\return <i>void</i>
+*/
+    void resize(uint32_t width, uint32_t height) {
+        m_width = width;
+        m_height = height;
+        m_canvas = std::make_shared<Canvas>(m_width, m_height);
+        m_painter.setCanvas(m_canvas);
+        resetTiles();
+        bindVisibleFigures();
+        redraw();
+    }
+
+ /*!
+Устанавливает видимую область сцены: точку сцены в левом верхнем углу холста и масштаб.
+Накопленные изменения сначала отрисовываются в прежней области
+\param origin точка сцены в левом верхнем углу холста
+\param scale масштаб, пикселей холста на единицу сцены
+\return <i>void</i>
+*/
+    void setViewport(const GraphicPrimitive::Point& origin, double scale) {
+        if(!(scale > 0)) {
+            return;
+        }
+
+        flush();
+        Transform previous = m_transform;
+        bool aggregated = m_aggregated;
+        m_transform = {origin, scale};
+        m_painter.setTransform(m_transform);
+        rebindTiles();
+        if(!isBound()) {
+            m_painter.clearAll();
+            return;
+        }
+
+        double shiftX = (previous.origin.x - origin.x) * scale;
+        double shiftY = (previous.origin.y - origin.y) * scale;
+        bool scroll = scale == previous.scale && aggregated == m_aggregated && shiftX == std::round(shiftX) && shiftY == std::round(shiftY) &&
+                      std::abs(shiftX) < m_width && std::abs(shiftY) < m_height;
+        if(!scroll) {
+            m_patternX = patternOffset(-origin.x * scale);
+            m_patternY = patternOffset(-origin.y * scale);
+            invalidate(m_canvas->area());
+        }
+        else if(shiftX != 0 || shiftY != 0) {
+            m_patternX = (m_patternX + int(shiftX)) & 7;
+            m_patternY = (m_patternY + int(shiftY)) & 7;
+            m_canvas->scroll(int(shiftX), int(shiftY));
+            double stripX = shiftX > 0 ? 0 : m_width + shiftX;
+            double stripY = shiftY > 0 ? 0 : m_height + shiftY;
+            invalidate({{stripX, 0}, std::abs(shiftX), double(m_height)});
+            invalidate({{0, stripY}, double(m_width), std::abs(shiftY)});
+        }
+        m_painter.setPatternOrigin(m_patternX, m_patternY);
+        if(m_repaintMode == RepaintMode::Immediate) {
+            updateTiles();
+        }
+    }
+
+ /*!
+Сдвигает видимую область сцены
+\param dx сдвиг изображения по оси x в пикселях холста
+\param dy сдвиг изображения по оси y в пикселях холста
+\return <i>void</i>
+*/
+    void pan(double dx, double dy) {
+        setViewport({m_transform.origin.x - dx / m_transform.scale, m_transform.origin.y - dy / m_transform.scale}, m_transform.scale);
+    }
+
+ /*!
+Изменяет масштаб так, что точка сцены под указанной точкой холста остается на месте
+\param factor множитель масштаба
+\param anchor неподвижная точка холста
+\return <i>void</i>
+*/
+    void zoom(double factor, const GraphicPrimitive::Point& anchor) {
+        double scale = m_transform.scale * factor;
+        GraphicPrimitive::Point fixed = m_transform.unmap(anchor);
+        setViewport({fixed.x - anchor.x / scale, fixed.y - anchor.y / scale}, scale);
+    }
+
+ /*!
+Возвращает преобразование координат сцены в координаты холста
+\return <i>const Transform&</i>
+*/
+    const Transform& transform() const {
+        return m_transform;
+    }
+
+ /*!
+Устанавливает правила упрощения отрисовки при уменьшении и перерисовывает холст
+\param detail правила упрощения
+\return <i>void</i>
+*/
+    void setLevelOfDetail(const LevelOfDetail& detail) {
+        flush();
+        m_detail = detail;
+        m_painter.setLevelOfDetail(m_detail);
+        rebindTiles();
+        redraw();
+    }
+
+    const LevelOfDetail& levelOfDetail() const {
+        return m_detail;
+    }
+
+ /*!
+Возвращает видимую на холсте область сцены
+\return <i>Area</i>
+*/
+    Area visibleArea() const {
+        return m_transform.unmap(m_canvas->area());
+    }
+
+ /*!
+Полностью перерисовывает холст: все плитки помечаются устаревшими и растеризуются заново
+\return <i>void</i>
+*/
+    void redraw() {
+        if(!isBound()) {
+            m_painter.clearAll();
+            return;
+        }
+
+        m_dirtyRegion.clear();
+        for(uint32_t tile = 0; tile < m_tiles.size(); tile++) {
+            markTileDirty(tile);
+        }
+        updateTiles();
+    }
+
+ /*!
+Возвращает индекс в модели самой верхней фигуры под точкой. Кандидаты берутся из пространственного индекса сверху вниз
+и проверяются по точной геометрии примитива до первого попадания. Точку холста переводит в сцену <i>transform().unmap()</i>
+\param point точка сцены
+\param tolerance допуск попадания в пикселях холста, переводится в единицы сцены по масштабу
+\return <i>size_t</i> индекс фигуры, количество фигур модели если под точкой нет фигуры
+*/
+    size_t figureAt(const GraphicPrimitive::Point& point, double tolerance = 0) const {
+        if(!isBound()) {
+            return 0;
+        }
+
+        tolerance /= m_transform.scale;
+        double reach = std::max(tolerance, 0.5);
+        size_t id = m_index.findTopmost({{point.x - reach, point.y - reach}, 2 * reach, 2 * reach}, [this, &point, tolerance](size_t id) {
+            return hitTest(sourceFigure(indexOf(id)), point, tolerance);
+        });
+        return id == SpatialIndex::NotFound ? m_figureIds.size() : indexOf(id);
+    }
+
+ /*!
+Возвращает индексы в модели фигур, выбранных областью, в порядке отрисовки (z-order)
+\param area область выбора в координатах сцены
+\param selectionMode правило выбора
+\return <i>std::vector<size_t></i>
+*/
+    std::vector<size_t> figuresInArea(const Area& area, SelectionMode selectionMode = SelectionMode::Contained) const {
+        std::vector<size_t> result;
+        if(!isBound()) {
+            return result;
+        }
+
+        for(auto id : m_index.query(area)) {
+            size_t index = indexOf(id);
+            const auto& figure = sourceFigure(index);
+            if(selectionMode == SelectionMode::Contained ? area.contains(figureBounds(figure)) : intersectsArea(figure, area)) {
+                result.push_back(index);
+            }
+        }
+        return result;
+    }
+
 private:
  /*!
-Добавляет отображение графического примитива
+Возвращает <i>true</i>, если объект связан с моделью или снимком
+\return <i>bool</i>
+*/
+    bool isBound() const {
+        return m_model || m_snapshotSource;
+    }
+
+ /*!
+Возвращает графический примитив модели или снимка, с которым связан объект
 \param index индекс графического примитива
+\return <i>const GraphicPrimitive::FigureValue&</i>
+*/
+    const GraphicPrimitive::FigureValue& sourceFigure(size_t index) const {
+        return m_model ? m_model->figure(index) : m_snapshot.figure(index);
+    }
+
+ /*!
+Добавляет отображение диапазона графических примитивов
+\param first индекс первого графического примитива
+\param count количество графических примитивов
 \return <i>void</i>
 */
-    void addFigure(size_t index) {
-        auto figure = m_model->data(index);
+    void addFigures(size_t first, size_t count) {
+        auto firstId = m_nextFigureId;
+        m_nextFigureId += count;
 
-        switch (figure->type()) {
-        case GraphicPrimitive::FigureType::None:
-            break;
-        default:
-            m_renderFigureAreas.push_back(drawFigure(figure));
+        std::vector<size_t> ids(count);
+        for(size_t i = 0; i < count; i++) {
+            ids[i] = firstId + i;
+        }
+        m_figureIds.insert(std::next(m_figureIds.begin(), first), ids.begin(), ids.end());
+
+        std::vector<Area> bounds(count);
+        auto calcBounds = [this, first, &bounds](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                bounds[i] = figureBounds(sourceFigure(first + i)).aligned();
+            }
+        };
+        if(m_scheduler && count > BoundsGrain) {
+            m_scheduler->parallelFor(count, BoundsGrain, calcBounds, Scheduler::Priority::Normal);
+        }
+        else {
+            calcBounds(0, count);
+        }
+
+        bool deferred = m_repaintMode == RepaintMode::Deferred;
+        bool onTop = first + count == m_figureIds.size();
+        bool rasterize = !deferred && (m_aggregated || !onTop || count >= TiledRenderThreshold);
+        for(size_t i = 0; i < count; i++) {
+            const auto& figure = sourceFigure(first + i);
+            m_index.insert(ids[i], bounds[i], figureColor(figure));
+            bool bound = bindsToTiles(bounds[i]);
+            bounds[i] = bound ? screenBounds(bounds[i]) : aggregateBounds(bounds[i]);
+            if(bound) {
+                bindFigure(ids[i], figure, bounds[i], rasterize);
+            }
+            else if(rasterize) {
+                invalidate(bounds[i]);
+            }
+            if(deferred) {
+                m_dirtyRegion.add(bounds[i]);
+            }
+        }
+
+        if(deferred) {
+            return;
+        }
+
+        if(rasterize) {
+            updateTiles();
+            return;
+        }
+
+        Area canvasArea = m_canvas->area();
+        for(size_t i = 0; i < count; i++) {
+            if(bounds[i].intersects(canvasArea)) {
+                m_painter.drawFigure(sourceFigure(first + i));
+            }
         }
     }
 
  /*!
-Удаляет отображение графического примитива
-\param index индекс графического примитива
+Удаляет отображение диапазона графических примитивов, плитки, которые задевали удаленные примитивы, растеризуются заново один раз
+\param first индекс первого графического примитива
+\param count количество графических примитивов
 \return <i>void</i>
 */
-    void removeFigure(size_t index) {
-        auto removedAreaItr = std::next(m_renderFigureAreas.begin(), index);
-        auto removedArea = *removedAreaItr;
+    void removeFigures(size_t first, size_t count) {
+        if(first >= m_figureIds.size()) {
+            return;
+        }
 
-        m_renderFigureAreas.erase(removedAreaItr);
-        m_painter.clearArea(removedArea);
+        auto removedBegin = std::next(m_figureIds.begin(), first);
+        auto removedEnd = std::next(removedBegin, std::min(count, m_figureIds.size() - first));
 
-        auto rerenderAreas = calcRerenderAreas(removedArea);
-        for(const auto& area : rerenderAreas) {
-            m_painter.clearArea(area.second);
+        bool deferred = m_repaintMode == RepaintMode::Deferred;
+        for(auto idItr = removedBegin; idItr != removedEnd; ++idItr) {
+            Area sceneBounds = m_index.bounds(*idItr);
+            bool bound = bindsToTiles(sceneBounds);
+            Area bounds = bound ? screenBounds(sceneBounds) : aggregateBounds(sceneBounds);
+            unbindFigure(*idItr, bounds, !deferred);
+            if(deferred) {
+                m_dirtyRegion.add(bounds);
+            }
+            else if(!bound) {
+                invalidate(bounds);
+            }
+            m_index.remove(*idItr);
+        }
+        m_figureIds.erase(removedBegin, removedEnd);
+        if(!deferred) {
+            updateTiles();
         }
+    }
 
-        for(const auto& area : rerenderAreas) {
-            drawFigure(m_model->data(area.first));
+ /*!
+Возвращает индекс графического примитива в модели по идентификатору отображаемой фигуры. Идентификаторы выдаются подряд по возрастанию,
+поэтому индекс не больше разности с первым идентификатором и равен ей, если перед фигурой ничего не удалялось
+\param id идентификатор фигуры
+\return <i>size_t</i>
+*/
+    size_t indexOf(size_t id) const {
+        auto last = m_figureIds.end();
+        if(!m_figureIds.empty() && id >= m_figureIds.front() && id - m_figureIds.front() < m_figureIds.size()) {
+            size_t guess = id - m_figureIds.front();
+            if(m_figureIds[guess] == id) {
+                return guess;
+            }
+            last = std::next(m_figureIds.begin(), guess);
         }
+        return size_t(std::distance(m_figureIds.begin(), std::lower_bound(m_figureIds.begin(), last, id)));
     }
 
  /*!
-Отрисовывает графический примитив
-\param figure графический примитив
+Проверяет, проходит ли отрезок через плитку: углы плитки, расширенной на половину толщины кисти и запас округления
+до пикселей, не должны лежать по одну сторону от прямой отрезка. Пересечение по осям обеспечивает область отрезка
+\param p1 начало отрезка на холсте
+\param p2 конец отрезка на холсте
+\param half половина толщины кисти на холсте
+\param column номер столбца плитки
+\param row номер строки плитки
+\return <i>bool</i>
+*/
+    static bool segmentCrossesTile(const GraphicPrimitive::Point& p1, const GraphicPrimitive::Point& p2, double half, uint32_t column, uint32_t row) {
+        double margin = 2 + half;
+        double normalX = p1.y - p2.y;
+        double normalY = p2.x - p1.x;
+        double x0 = double(column * TileSize) - margin;
+        double y0 = double(row * TileSize) - margin;
+        double x1 = x0 + TileSize + 2 * margin;
+        double y1 = y0 + TileSize + 2 * margin;
+
+        bool positive = false;
+        bool negative = false;
+        for(auto corner : {GraphicPrimitive::Point{x0, y0}, GraphicPrimitive::Point{x1, y0}, GraphicPrimitive::Point{x0, y1}, GraphicPrimitive::Point{x1, y1}}) {
+            double side = normalX * (corner.x - p1.x) + normalY * (corner.y - p1.y);
+            positive = positive || side >= 0;
+            negative = negative || side <= 0;
+        }
+        return positive && negative;
+    }
+
+ /*!
+Возвращает остаток от деления на размер узора заливки для ближайшего к смещению целого пикселя
+\param offset смещение начала координат сцены на холсте
+\return <i>int</i>
+*/
+    static int patternOffset(double offset) {
+        return int(std::fmod(std::round(offset), 8.0)) & 7;
+    }
+
+ /*!
+Возвращает выровненную по пикселям область фигуры на холсте
+\param bounds область фигуры в координатах сцены
 \return <i>Area</i>
 */
-    Area drawFigure(const std::shared_ptr<GraphicPrimitive::Figure>& figure) {
-        switch (figure->type()) {
-        case GraphicPrimitive::FigureType::None:
-            return {};
-        case GraphicPrimitive::FigureType::Circle:
-            return m_painter.drawFigure(*dynamic_cast<GraphicPrimitive::Circle*>(figure.get()));
-        case GraphicPrimitive::FigureType::Ellipse:
-            return m_painter.drawFigure(*dynamic_cast<GraphicPrimitive::Ellipse*>(figure.get()));
-        case GraphicPrimitive::FigureType::Line:
-            return m_painter.drawFigure(*dynamic_cast<GraphicPrimitive::Line*>(figure.get()));
-        case GraphicPrimitive::FigureType::Rectangle:
-            return m_painter.drawFigure(*dynamic_cast<GraphicPrimitive::Rectangle*>(figure.get()));
-        case GraphicPrimitive::FigureType::Square:
-            return m_painter.drawFigure(*dynamic_cast<GraphicPrimitive::Square*>(figure.get()));
-        default:
-            return {};
+    Area screenBounds(const Area& bounds) const {
+        return m_transform.mapBounds(bounds).aligned();
+    }
+
+ /*!
+Возвращает область на холсте, которую задевает изменение фигуры, рисуемой грубым представлением: ячейки пирамиды индекса,
+в которые она попадает
+\param bounds область фигуры в координатах сцены
+\return <i>Area</i>
+*/
+    Area aggregateBounds(const Area& bounds) const {
+        return screenBounds(m_index.aggregateArea(bounds, 1 / m_transform.scale));
+    }
+
+ /*!
+Возвращает <i>true</i>, если фигура рисуется из списков плиток, а не грубым представлением ячеек индекса
+\param bounds область фигуры в координатах сцены
+\return <i>bool</i>
+*/
+    bool bindsToTiles(const Area& bounds) const {
+        return !m_aggregated || m_index.isLarge(bounds);
+    }
+
+ /*!
+Строит списки плиток заново для текущей видимой области и выбирает, рисуются ли вместо мелких фигур грубые представления ячеек
+\return <i>void</i>
+*/
+    void rebindTiles() {
+        m_aggregated = m_transform.scale * m_index.cellSize() < m_detail.aggregateCellSize;
+        for(auto& ids : m_tiles) {
+            ids.clear();
+        }
+        bindVisibleFigures();
+    }
+
+ /*!
+Добавляет в списки плиток фигуры, видимые на холсте. Кандидаты берутся запросом к пространственному индексу
+по видимой области сцены, расширенной на пиксель, при грубом представлении - только среди крупных фигур
+\return <i>void</i>
+*/
+    void bindVisibleFigures() {
+        if(!isBound()) {
+            return;
+        }
+
+        Area visible = m_transform.unmap({{-1, -1}, double(m_width) + 2, double(m_height) + 2});
+        for(auto id : m_aggregated ? m_index.queryLarge(visible) : m_index.query(visible)) {
+            const auto& figure = sourceFigure(indexOf(id));
+            bindFigure(id, figure, screenBounds(figureBounds(figure).aligned()), false);
         }
     }
 
  /*!
-Расчитывает области, которые необходимо отрисовать заново
-\param clearArea область, которая была очищена после удаления графического примитива
-\return <i>std::map<size_t, Area></i>
+Помечает устаревшей область холста: в режиме отложенной перерисовки она накапливается до вызова <i>flush()</i>
+\param area область холста
+\return <i>void</i>
 */
-    std::map<size_t, Area> calcRerenderAreas(const Area& clearArea) {
-        return {};
+    void invalidate(const Area& area) {
+        if(m_repaintMode == RepaintMode::Deferred) {
+            m_dirtyRegion.add(area);
+            return;
+        }
+
+        forEachTile(area, [this, &area](uint32_t tile, uint32_t, uint32_t) {
+            markTileDirty(tile, area);
+        });
+    }
+
+ /*!
+Пересоздает сетку плиток по размерам холста, списки фигур плиток очищаются
+\return <i>void</i>
+*/
+    void resetTiles() {
+        m_tileColumns = (m_width + TileSize - 1) / TileSize;
+        m_tileRows = (m_height + TileSize - 1) / TileSize;
+        m_tiles.clear();
+        m_tiles.resize(size_t(m_tileColumns) * m_tileRows);
+        m_tileDirtyArea.assign(m_tiles.size(), Area());
+        m_dirtyTiles.clear();
+    }
+
+ /*!
+Вызывает функцию для номера каждой плитки, которую задевает область
+\param area область
+\param function вызываемый объект с параметрами (номер плитки, столбец, строка)
+\return <i>void</i>
+*/
+    template<typename Function>
+    void forEachTile(const Area& area, Function function) const {
+        Area region = area.intersected(m_canvas->area());
+        if(region.isEmpty()) {
+            return;
+        }
+
+        auto column0 = uint32_t(region.corner.x) / TileSize;
+        auto row0 = uint32_t(region.corner.y) / TileSize;
+        auto column1 = std::min(m_tileColumns - 1, uint32_t(std::ceil(region.right()) - 1) / TileSize);
+        auto row1 = std::min(m_tileRows - 1, uint32_t(std::ceil(region.bottom()) - 1) / TileSize);
+        for(auto row = row0; row <= row1; row++) {
+            for(auto column = column0; column <= column1; column++) {
+                function(row * m_tileColumns + column, column, row);
+            }
+        }
+    }
+
+ /*!
+Возвращает область плитки на холсте
+\param tile номер плитки
+\return <i>Area</i>
+*/
+    Area tileArea(uint32_t tile) const {
+        Area area = {{double(tile % m_tileColumns * TileSize), double(tile / m_tileColumns * TileSize)}, double(TileSize), double(TileSize)};
+        return area.intersected(m_canvas->area());
+    }
+
+ /*!
+Помечает часть плитки устаревшей
+\param tile номер плитки
+\param area устаревшая область, по умолчанию вся плитка
+\return <i>void</i>
+*/
+    void markTileDirty(uint32_t tile, const Area& area = Area()) {
+        Area tileRect = tileArea(tile);
+        Area dirty = area.isEmpty() ? tileRect : area.intersected(tileRect);
+        if(dirty.isEmpty()) {
+            return;
+        }
+
+        if(m_tileDirtyArea[tile].isEmpty()) {
+            m_dirtyTiles.push_back(tile);
+        }
+        m_tileDirtyArea[tile] = m_tileDirtyArea[tile].united(dirty);
+    }
+
+ /*!
+Добавляет фигуру в списки плиток, которые задевает ее область. Отрезок добавляется только в плитки, через которые проходит
+\param id идентификатор фигуры
+\param figure графический примитив
+\param bounds область фигуры на холсте
+\param invalidate пометить задетые плитки устаревшими
+\return <i>void</i>
+*/
+    void bindFigure(size_t id, const GraphicPrimitive::FigureValue& figure, const Area& bounds, bool invalidate) {
+        auto line = std::get_if<GraphicPrimitive::Line>(&figure);
+        GraphicPrimitive::Point p1 = line ? m_transform.map(line->p1()) : GraphicPrimitive::Point{0, 0};
+        GraphicPrimitive::Point p2 = line ? m_transform.map(line->p2()) : GraphicPrimitive::Point{0, 0};
+        double half = line ? std::max(line->penWidth() * m_transform.scale, 1.0) / 2 : 0;
+        forEachTile(bounds, [this, id, line, &p1, &p2, half, invalidate, &bounds](uint32_t tile, uint32_t column, uint32_t row) {
+            if(line && !segmentCrossesTile(p1, p2, half, column, row)) {
+                return;
+            }
+
+            auto& ids = m_tiles[tile];
+            if(ids.empty() || ids.back() < id) {
+                ids.push_back(id);
+            }
+            else {
+                ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+            }
+            if(invalidate) {
+                markTileDirty(tile, bounds);
+            }
+        });
+    }
+
+ /*!
+Удаляет фигуру из списков плиток и помечает устаревшей занятую ею часть плиток, в которых она была
+\param id идентификатор фигуры
+\param bounds область фигуры на холсте
+\param invalidate пометить задетые плитки устаревшими
+\return <i>void</i>
+*/
+    void unbindFigure(size_t id, const Area& bounds, bool invalidate) {
+        forEachTile(bounds, [this, id, &bounds, invalidate](uint32_t tile, uint32_t, uint32_t) {
+            auto& ids = m_tiles[tile];
+            auto idItr = std::lower_bound(ids.begin(), ids.end(), id);
+            if(idItr != ids.end() && *idItr == id) {
+                ids.erase(idItr);
+                if(invalidate) {
+                    markTileDirty(tile, bounds);
+                }
+            }
+        });
+    }
+
+ /*!
+Растеризует заново устаревшие части плиток: устаревшая часть очищается, и фигуры плитки, задевающие ее, рисуются отдельным
+художником с отсечением по этой части. Поэтому стоимость правки зависит от задетой площади, а не от количества фигур сцены.
+Остальные плитки остаются на холсте и учитываются как попадания в кэш. С планировщиком плитки рисуются параллельно
+\return <i>void</i>
+*/
+    void updateTiles() {
+        if(m_dirtyTiles.empty()) {
+            return;
+        }
+
+        m_tileStatistics.hits += m_tiles.size() - m_dirtyTiles.size();
+        m_tileStatistics.misses += m_dirtyTiles.size();
+        if(m_aggregated) {
+            m_index.refreshAggregates();
+        }
+
+        auto drawTiles = [this](size_t begin, size_t end) {
+            Painter painter;
+            painter.setCanvas(m_canvas);
+            painter.setTransform(m_transform);
+            painter.setLevelOfDetail(m_detail);
+            painter.setPatternOrigin(m_patternX, m_patternY);
+            for(size_t i = begin; i < end; i++) {
+                auto tile = m_dirtyTiles[i];
+                Area area = m_tileDirtyArea[tile];
+                Area tileRect = tileArea(tile);
+                bool wholeTile = area.width == tileRect.width && area.height == tileRect.height;
+                painter.setClip(area);
+                painter.clearArea(area);
+                if(m_aggregated) {
+                    m_index.forEachAggregate(m_transform.unmap(area), 1 / m_transform.scale, [&painter, this](const Area& cell, uint32_t color) {
+                        painter.fillArea(m_transform.map(cell), color);
+                    });
+                }
+                for(auto id : m_tiles[tile]) {
+                    const auto& figure = sourceFigure(indexOf(id));
+                    if(wholeTile || screenBounds(figureBounds(figure)).intersects(area)) {
+                        painter.drawFigure(figure);
+                    }
+                }
+            }
+        };
+
+        if(m_renderMode == RenderMode::Tiled && m_scheduler && m_dirtyTiles.size() > 1) {
+            m_scheduler->parallelFor(m_dirtyTiles.size(), 1, drawTiles, Scheduler::Priority::Interactive);
+        }
+        else {
+            drawTiles(0, m_dirtyTiles.size());
+        }
+
+        for(auto tile : m_dirtyTiles) {
+            m_tileDirtyArea[tile] = Area();
+        }
+        m_dirtyTiles.clear();
     }
 };
 
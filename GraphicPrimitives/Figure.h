@@ -71,6 +71,8 @@ public:
 
     }
 
+    Figure& operator=(const Figure& other) = default;
+
     uint32_t penColor() const {
         return m_penColor;
     }
@@ -132,6 +134,8 @@ public:
 
     }
 
+    InvalidFigure& operator=(const InvalidFigure& other) = default;
+
     uint32_t penColor() const = delete;
     void setPenColor(uint32_t color) = delete;
 
@@ -182,6 +186,8 @@ public:
 
     }
 
+    Line& operator=(const Line& other) = default;
+
     uint32_t brushColor() const = delete;
     void setBrushColor(uint32_t color) = delete;
 
@@ -243,6 +249,8 @@ public:
 
     }
 
+    Rectangle& operator=(const Rectangle& other) = default;
+
     Point corner() const {
         return m_corner;
     }
@@ -301,6 +309,8 @@ public:
 
     }
 
+    Circle& operator=(const Circle& other) = default;
+
     Point center() const {
         return m_center;
     }
@@ -351,6 +361,8 @@ public:
 
     }
 
+    Square& operator=(const Square& other) = default;
+
     Point corner() const {
         return m_corner;
     }
@@ -406,6 +418,8 @@ public:
 
     }
 
+    Ellipse& operator=(const Ellipse& other) = default;
+
     Point center() const {
         return m_center;
     }
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <variant>
+#include <memory>
+
+#include "Figure.h"
+
+namespace GraphicPrimitive {
+
+/*!
+\brief Графический примитив, хранимый по значению
+
+Позволяет хранить графические примитивы разных типов в непрерывной памяти без отдельного выделения памяти на каждый примитив.
+Пустое значение содержит InvalidFigure
+*/
+using FigureValue = std::variant<InvalidFigure, Line, Rectangle, Circle, Square, Ellipse>;
+
+/*!
+Возвращает ссылку на базовый класс графического примитива, хранимого по значению
+\param value графический примитив
+\return <i>Figure&</i>
+*/
+inline Figure& asFigure(FigureValue& value) {
+    return std::visit([](auto& figure) -> Figure& { return figure; }, value);
+}
+
+inline const Figure& asFigure(const FigureValue& value) {
+    return std::visit([](const auto& figure) -> const Figure& { return figure; }, value);
+}
+
+/*!
+Копирует графический примитив, доступный через указатель на базовый класс, в значение
+\param figure указатель на графический примитив
+\return <i>FigureValue</i>
+*/
+inline FigureValue toFigureValue(const std::shared_ptr<Figure>& figure) {
+    if(!figure) {
+        return InvalidFigure();
+    }
+
+    switch (figure->type()) {
+    case FigureType::Line:
+        return *static_cast<const Line*>(figure.get());
+    case FigureType::Rectangle:
+        return *static_cast<const Rectangle*>(figure.get());
+    case FigureType::Circle:
+        return *static_cast<const Circle*>(figure.get());
+    case FigureType::Square:
+        return *static_cast<const Square*>(figure.get());
+    case FigureType::Ellipse:
+        return *static_cast<const Ellipse*>(figure.get());
+    default:
+        return InvalidFigure();
+    }
+}
+
+}
@@ -1,2 +1,3 @@
 #include "Point.h"
 #include "Figure.h"
+#include "FigureValue.h"
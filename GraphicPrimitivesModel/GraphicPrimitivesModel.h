@@ -5,8 +5,14 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <algorithm>
 
 #include "GraphicPrimitives/GraphicPrimitives.h"
+#include "PersistentArray.h"
 /*!
 \brief Классы моделей для хранения графических примитивов
 \author Алексей Волков
@@ -18,46 +24,389 @@
 namespace Model {
 
 using CallbackType = std::function<void(size_t)>; ///< тип callback-а
+using RangeCallbackType = std::function<void(size_t, size_t)>; ///< тип callback-а на диапазон: первый индекс и количество
+
+/*!
+\brief Стабильный идентификатор графического примитива в модели
+
+Остается действительным, пока не удален сам графический примитив, удаление других примитивов на него не влияет
+*/
+struct FigureHandle {
+    uint32_t slot = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+
+    bool operator==(const FigureHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const FigureHandle& other) const {
+        return !(*this == other);
+    }
+};
 
 /*!
 \brief Классы модели для работы с графическими притивами
 
-Класс, который позволяют хранить, добавлять, удалять графические примитивы, синхронизируется осуществляется через callback-и
+Класс, который позволяют хранить, добавлять, удалять графические примитивы, синхронизируется осуществляется через callback-и.
+Примитивы хранятся по значению в слотах с счетчиками поколений, порядок отрисовки задается массивом номеров слотов,
+поэтому доступ по индексу и по идентификатору выполняется за O(1). Слоты выделяются листами (PersistentArray), адреса примитивов
+не меняются при добавлении новых, память выделяется один раз на лист, а не на каждый примитив.
+Вся память модели выделяется из переданного источника памяти (например, арены проекта).
+
+Листы слотов и порядка отрисовки разделяются между моделью и ее снимками (<i>snapshot()</i>): изменение копирует
+только затронутый лист и его каталог, если они еще используются снимком.
+
+Модель допускает одного писателя и много читателей. Изменения и подключение callback-ов сериализуются мьютексом записи,
+после каждой операции изменения (или пакета) новая версия публикуется атомарной заменой указателя. Читатели в других потоках
+получают опубликованную версию через <i>snapshot()</i> без блокировок и работают с ней, пока держат снимок.
+Callback-и вызываются в потоке писателя под мьютексом записи, по порядку подключения, после публикации версии, которую они описывают,
+кроме callback-ов внутри пакета изменений (см. <i>BatchGuard</i>).
+Остальные методы чтения предназначены для потока писателя и callback-ов
 */
-class GraphicPrimitivesModel {    
-    std::list<std::shared_ptr<GraphicPrimitive::Figure>> m_figures;
-    std::map<size_t, CallbackType> m_figureAddedCallbacks;
-    std::map<size_t, CallbackType> m_figureRemovedCallbacks;
+class GraphicPrimitivesModel {
+    static constexpr uint32_t NoSlot = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t SlotLeafBits = 5;  ///< слотов в листе: 32, лист вместе с блоком управления не больше 4 КБ,
+                                               ///< поэтому листы выделяются из пулов арены, а не поштучно из кучи
+    static constexpr size_t OrderLeafBits = 9; ///< номеров слотов в листе порядка отрисовки: 512
+
+    /// Слот хранения графического примитива
+    struct Slot {
+        GraphicPrimitive::FigureValue figure;
+        uint32_t generation = 0;
+        uint32_t nextFree = NoSlot;
+        bool used = false;
+    };
+
+    /// Версия содержимого модели, листы слотов и порядка отрисовки разделяются между версиями
+    struct State {
+        PersistentArray<Slot, SlotLeafBits> slots;
+        PersistentArray<uint32_t, OrderLeafBits> order;
+
+        explicit State(std::pmr::memory_resource* resource) : slots(resource), order(resource) {
+
+        }
+
+        const Slot& slot(uint32_t index) const {
+            return slots[index];
+        }
+
+        uint32_t slotAt(size_t index) const {
+            return order[index];
+        }
+
+        bool contains(FigureHandle handle) const {
+            return handle.slot < slots.size() && slots[handle.slot].used && slots[handle.slot].generation == handle.generation;
+        }
+    };
+
+    std::pmr::memory_resource* m_resource;
+    std::shared_ptr<State> m_state;     ///< рабочая версия писателя
+    std::shared_ptr<State> m_published; ///< опубликованная версия, читается и заменяется только атомарно
+    bool m_changed = false;
+    mutable std::recursive_mutex m_writeMutex;
+    uint32_t m_freeSlot = NoSlot;
+    std::pmr::vector<uint32_t> m_positions; ///< индекс в порядке отрисовки для каждого занятого слота рабочей версии
+    std::pmr::map<size_t, RangeCallbackType> m_figureAddedCallbacks;
+    std::pmr::map<size_t, RangeCallbackType> m_figureRemovedCallbacks;
+    size_t m_nextConnectionIndex = 0;
+
+    size_t m_batchDepth = 0;
+    size_t m_pendingAddedCount = 0;
 
 public:
-    GraphicPrimitivesModel() {
+/*!
+\brief Пакетное изменение модели
+
+Пока объект существует, добавления графических примитивов не вызывают callback-и. При разрушении последнего объекта
+все добавленные примитивы передаются callback-ам одним диапазоном. Удаление внутри пакета сначала отправляет накопленный диапазон.
+Пакет удерживает мьютекс записи и публикуется читателям одной версией при разрушении последнего объекта.
+Поэтому callback-и, вызванные внутри пакета (удаление и отправленный перед ним диапазон добавлений), опережают публикацию:
+<i>snapshot()</i> в них еще не содержит изменений пакета, а методы чтения писателя и <i>currentSnapshot()</i> уже содержат.
+Диапазон, отправляемый при разрушении последнего объекта, передается callback-ам после публикации
+*/
+    class BatchGuard {
+        GraphicPrimitivesModel& m_model;
+        std::lock_guard<std::recursive_mutex> m_lock;
+
+    public:
+        explicit BatchGuard(GraphicPrimitivesModel& model) : m_model(model), m_lock(model.m_writeMutex) {
+            m_model.m_batchDepth++;
+        }
+
+        BatchGuard(const BatchGuard&) = delete;
+        BatchGuard& operator=(const BatchGuard&) = delete;
+
+        ~BatchGuard() {
+            if(--m_model.m_batchDepth == 0) {
+                m_model.publish();
+                m_model.flushPendingAdded();
+            }
+        }
+    };
+
+/*!
+\brief Неизменяемый снимок модели
+
+Создается за O(1) и разделяет листы с моделью, поэтому фоновое сохранение или отрисовка работают с согласованной версией,
+пока модель продолжает изменяться. Листы, которые модель изменила после создания снимка, живут, пока жив снимок.
+Снимок можно читать и освобождать в любом потоке, источник памяти модели должен допускать освобождение из других потоков
+*/
+    class Snapshot {
+        std::shared_ptr<const State> m_state;
+
+    public:
+        Snapshot() {
+
+        }
+
+        explicit Snapshot(std::shared_ptr<const State> state) : m_state(std::move(state)) {
+
+        }
+
+/*!
+Возвращает количество графических примитивов в снимке
+\return <i>size_t</i>
+*/
+        size_t count() const {
+            return m_state ? m_state->order.size() : 0;
+        }
+
+/*!
+Возвращает графический примитив, InvalidFigure если индекс вне диапазона
+\param index индекс графического примитива
+\return <i>const GraphicPrimitive::FigureValue&</i>
+*/
+        const GraphicPrimitive::FigureValue& figure(size_t index) const {
+            static const GraphicPrimitive::FigureValue invalid;
+            if(index >= count()) {
+                return invalid;
+            }
+
+            return m_state->slot(m_state->slotAt(index)).figure;
+        }
+
+/*!
+Возвращает графический примитив по идентификатору, InvalidFigure если идентификатор недействителен в снимке
+\param handle идентификатор графического примитива
+\return <i>const GraphicPrimitive::FigureValue&</i>
+*/
+        const GraphicPrimitive::FigureValue& figure(FigureHandle handle) const {
+            static const GraphicPrimitive::FigureValue invalid;
+            if(!m_state || !m_state->contains(handle)) {
+                return invalid;
+            }
+
+            return m_state->slot(handle.slot).figure;
+        }
+
+/*!
+Возвращает идентификатор графического примитива, недействительный идентификатор если индекс вне диапазона
+\param index индекс графического примитива
+\return <i>FigureHandle</i>
+*/
+        FigureHandle handle(size_t index) const {
+            if(index >= count()) {
+                return {};
+            }
+
+            auto slotIndex = m_state->slotAt(index);
+            return {slotIndex, m_state->slot(slotIndex).generation};
+        }
+    };
+
+    explicit GraphicPrimitivesModel(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        m_resource(resource),
+        m_state(std::allocate_shared<State>(std::pmr::polymorphic_allocator<State>(resource), resource)),
+        m_published(m_state),
+        m_positions(resource),
+        m_figureAddedCallbacks(resource),
+        m_figureRemovedCallbacks(resource)
+    {
     }
 
-    GraphicPrimitivesModel(std::list<std::shared_ptr<GraphicPrimitive::Figure>>&& figures) : m_figures(figures){
+    GraphicPrimitivesModel(std::list<std::shared_ptr<GraphicPrimitive::Figure>>&& figures, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        GraphicPrimitivesModel(resource)
+    {
+        for(const auto& figure : figures) {
+            insertFigure(GraphicPrimitive::toFigureValue(figure));
+        }
+        publish();
+    }
+
+/*!
+Возвращает неизменяемый снимок последней опубликованной версии модели. Выполняется за O(1) без блокировок из любого потока.
+Внутри пакета изменений снимок не содержит изменений пакета
+\return <i>Snapshot</i>
+*/
+    Snapshot snapshot() const {
+        return Snapshot(std::atomic_load(&m_published));
+    }
+
+/*!
+Возвращает неизменяемый снимок рабочей версии модели, включая изменения незавершенного пакета. Выполняется за O(1),
+предназначен для потока писателя и callback-ов: снимок описывает ровно те индексы, которые переданы callback-у.
+Следующее изменение модели скопирует каталоги листов, разделяемые со снимком
+\return <i>Snapshot</i>
+*/
+    Snapshot currentSnapshot() const {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        return Snapshot(m_state);
     }
 
 /*!
-Возвращает указатель на графический примитив
+Возвращает указатель на графический примитив. Указатель не владеет примитивом и действителен, пока примитив находится в модели
+и до следующего изменения модели. Лист примитива отделяется от снимков, поэтому изменение через указатель их не затрагивает
+и становится видно читателям со следующей публикацией
 \param index индекс графического примитива
 \return <i>std::shared_ptr<GraphicPrimitive::Figure></i>
 */
     std::shared_ptr<GraphicPrimitive::Figure> data(size_t index) {
-        if(index >= m_figures.size()) {
-            return std::make_shared<GraphicPrimitive::InvalidFigure>();
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        if(index >= count()) {
+            return invalidFigure();
         }
 
-        return *std::next(m_figures.begin(), index);
+        return borrowFigure(writableSlot(m_state->slotAt(index)).figure);
     }
 
 /*!
-Добавляет графический примитив в модель, вызывает callback-и
+Возвращает указатель на графический примитив по идентификатору
+\param handle идентификатор графического примитива
+\return <i>std::shared_ptr<GraphicPrimitive::Figure></i>
+*/
+    std::shared_ptr<GraphicPrimitive::Figure> data(FigureHandle handle) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        if(!contains(handle)) {
+            return invalidFigure();
+        }
+
+        return borrowFigure(writableSlot(handle.slot).figure);
+    }
+
+/*!
+Возвращает указатель на графический примитив только для чтения. В отличие от неконстантной версии не отделяет лист
+от снимков и не создает новую версию для публикации. Указатель действителен до следующего изменения модели
+\param index индекс графического примитива
+\return <i>std::shared_ptr<const GraphicPrimitive::Figure></i>
+*/
+    std::shared_ptr<const GraphicPrimitive::Figure> data(size_t index) const {
+        return borrowFigure(figure(index));
+    }
+
+/*!
+Возвращает указатель на графический примитив по идентификатору только для чтения, без отделения листа от снимков
+\param handle идентификатор графического примитива
+\return <i>std::shared_ptr<const GraphicPrimitive::Figure></i>
+*/
+    std::shared_ptr<const GraphicPrimitive::Figure> data(FigureHandle handle) const {
+        return borrowFigure(figure(handle));
+    }
+
+/*!
+Возвращает графический примитив, хранимый по значению, InvalidFigure если индекс вне диапазона
+\param index индекс графического примитива
+\return <i>const GraphicPrimitive::FigureValue&</i>
+*/
+    const GraphicPrimitive::FigureValue& figure(size_t index) const {
+        static const GraphicPrimitive::FigureValue invalid;
+        if(index >= count()) {
+            return invalid;
+        }
+
+        return slot(m_state->slotAt(index)).figure;
+    }
+
+/*!
+Возвращает графический примитив, хранимый по значению, по идентификатору, InvalidFigure если идентификатор недействителен
+\param handle идентификатор графического примитива
+\return <i>const GraphicPrimitive::FigureValue&</i>
+*/
+    const GraphicPrimitive::FigureValue& figure(FigureHandle handle) const {
+        static const GraphicPrimitive::FigureValue invalid;
+        if(!contains(handle)) {
+            return invalid;
+        }
+
+        return slot(handle.slot).figure;
+    }
+
+/*!
+Возвращает идентификатор графического примитива, недействительный идентификатор если индекс вне диапазона
+\param index индекс графического примитива
+\return <i>FigureHandle</i>
+*/
+    FigureHandle handle(size_t index) const {
+        if(index >= count()) {
+            return {};
+        }
+
+        auto slotIndex = m_state->slotAt(index);
+        return {slotIndex, slot(slotIndex).generation};
+    }
+
+/*!
+Возвращает <i>true</i>, если графический примитив с идентификатором находится в модели
+\param handle идентификатор графического примитива
+\return <i>bool</i>
+*/
+    bool contains(FigureHandle handle) const {
+        return m_state->contains(handle);
+    }
+
+/*!
+Возвращает текущий индекс графического примитива, количество примитивов если идентификатор недействителен. Выполняется за O(1):
+индекс хранится для каждого слота и обновляется при удалении вместе со сдвигом порядка отрисовки
+\param handle идентификатор графического примитива
+\return <i>size_t</i>
+*/
+    size_t indexOf(FigureHandle handle) const {
+        if(!contains(handle)) {
+            return count();
+        }
+
+        return m_positions[handle.slot];
+    }
+
+/*!
+Добавляет графический примитив в модель, вызывает callback-и, возвращает идентификатор добавленного примитива
 \param figure графический примитив
-\return <i>void</i>
+\return <i>FigureHandle</i>
 */
     template<typename Figure>
-    void addFigure(const Figure& figure) {
-        m_figures.push_back(std::make_shared<Figure>(figure));
-        figureAdded(m_figures.size() - 1);
+    FigureHandle addFigure(const Figure& figure) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        auto handle = insertFigure(makeFigure(figure));
+        figuresAdded(count() - 1, 1);
+        return handle;
+    }
+
+/*!
+Добавляет диапазон графических примитивов в модель, вызывает callback-и один раз для всего диапазона
+\param first начало диапазона
+\param last конец диапазона
+\return <i>void</i>
+*/
+    template<typename Iterator>
+    void addFigures(Iterator first, Iterator last) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        auto firstIndex = count();
+        for(; first != last; ++first) {
+            insertFigure(makeFigure(*first));
+        }
+
+        if(count() > firstIndex) {
+            figuresAdded(firstIndex, count() - firstIndex);
+        }
+    }
+
+/*!
+Добавляет контейнер графических примитивов в модель, вызывает callback-и один раз для всего контейнера
+\param figures контейнер графических примитивов
+\return <i>void</i>
+*/
+    template<typename Range>
+    void addFigures(const Range& figures) {
+        addFigures(std::begin(figures), std::end(figures));
     }
 
 /*!
@@ -66,12 +415,62 @@ public:
 \return <i>void</i>
 */
     void removeFigure(size_t index) {
-        if(index >= m_figures.size()) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        if(index >= count()) {
             return;
         }
 
-        m_figures.erase(std::next(m_figures.begin(), index));
-        figureRemoved(index);
+        flushPendingAdded();
+        releaseSlot(m_state->slotAt(index));
+        writableState().order.erase(index, 1);
+        updatePositions(index);
+        figuresRemoved(index, 1);
+    }
+
+/*!
+Удаляет набор графических примитивов из модели. Индексы группируются в непрерывные диапазоны, диапазоны удаляются,
+начиная с наибольших индексов, и для каждого диапазона callback-и вызываются один раз
+\param indices индексы графических примитивов, повторы и индексы вне диапазона игнорируются
+\return <i>void</i>
+*/
+    void removeFigures(std::vector<size_t> indices) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+        indices.erase(std::lower_bound(indices.begin(), indices.end(), count()), indices.end());
+        if(indices.empty()) {
+            return;
+        }
+
+        flushPendingAdded();
+
+        size_t runEnd = indices.size();
+        while(runEnd > 0) {
+            size_t runBegin = runEnd - 1;
+            while(runBegin > 0 && indices[runBegin - 1] + 1 == indices[runBegin]) {
+                runBegin--;
+            }
+
+            auto first = indices[runBegin];
+            auto count = runEnd - runBegin;
+            for(size_t index = first; index < first + count; index++) {
+                releaseSlot(m_state->slotAt(index));
+            }
+            writableState().order.erase(first, count);
+            updatePositions(first);
+            figuresRemoved(first, count);
+            runEnd = runBegin;
+        }
+    }
+
+/*!
+Удаляет графический примитив из модели по идентификатору, вызывает callback-и
+\param handle идентификатор графического примитива
+\return <i>void</i>
+*/
+    void removeFigure(FigureHandle handle) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        removeFigure(indexOf(handle));
     }
 
 /*!
@@ -79,7 +478,7 @@ public:
 \return <i>size_t</i>
 */
     size_t count() const {
-        return m_figures.size();
+        return m_state->order.size();
     }
 
 /*!
@@ -88,7 +487,21 @@ public:
 \return <i>size_t</i>
 */
     size_t connectToAddFigure(CallbackType callback) {
-        auto index = m_figureAddedCallbacks.size();
+        return connectToAddFigures([callback](size_t first, size_t count) {
+            for(size_t i = 0; i < count; i++) {
+                callback(first + i);
+            }
+        });
+    }
+
+/*!
+Подключает callback на добавление диапазона графических примитивов в модель, возвращает идентификатор подключения
+\param callback вызываемый объект, принимает первый индекс и количество добавленных примитивов
+\return <i>size_t</i>
+*/
+    size_t connectToAddFigures(RangeCallbackType callback) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        auto index = m_nextConnectionIndex++;
         m_figureAddedCallbacks[index] = callback;
         return index;
     }
@@ -99,6 +512,7 @@ public:
 \return <i>bool</i>
 */
     bool disconnectToAddFigure(size_t index) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
         return m_figureAddedCallbacks.erase(index);
     }
 
@@ -108,7 +522,21 @@ public:
 \return <i>size_t</i>
 */
     size_t connectToRemoveFigure(CallbackType callback) {
-        auto index = m_figureRemovedCallbacks.size();
+        return connectToRemoveFigures([callback](size_t first, size_t count) {
+            for(size_t i = count; i > 0; i--) {
+                callback(first + i - 1);
+            }
+        });
+    }
+
+/*!
+Подключает callback на удаление диапазона графических примитивов из модели, возвращает идентификатор подключения
+\param callback вызываемый объект, принимает первый индекс и количество удаленных примитивов
+\return <i>size_t</i>
+*/
+    size_t connectToRemoveFigures(RangeCallbackType callback) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
+        auto index = m_nextConnectionIndex++;
         m_figureRemovedCallbacks[index] = callback;
         return index;
     }
@@ -119,29 +547,181 @@ public:
 \return <i>bool</i>
 */
     bool disconnectToRemoveFigure(size_t index) {
+        std::lock_guard<std::recursive_mutex> lock(m_writeMutex);
         return m_figureRemovedCallbacks.erase(index);
     }
 
 private:
+    template<typename Figure>
+    static GraphicPrimitive::FigureValue makeFigure(const Figure& figure) {
+        return figure;
+    }
+
+    static GraphicPrimitive::FigureValue makeFigure(const std::shared_ptr<GraphicPrimitive::Figure>& figure) {
+        return GraphicPrimitive::toFigureValue(figure);
+    }
+
+    const Slot& slot(uint32_t index) const {
+        return m_state->slot(index);
+    }
+
 /*!
-Вызывает callback-и на добавление графического примитива
-\param index индекс графического примитива
+Возвращает версию содержимого для изменения: если версия используется снимком, модель переходит на ее копию,
+разделяющую со снимком все листы
+\return <i>State&</i>
+*/
+    State& writableState() {
+        if(m_state.use_count() > 1) {
+            m_state = std::allocate_shared<State>(std::pmr::polymorphic_allocator<State>(m_resource), *m_state);
+        }
+        m_changed = true;
+        return *m_state;
+    }
+
+/*!
+Публикует рабочую версию для читателей, если она изменилась. Следующее изменение перейдет на копию версии
 \return <i>void</i>
 */
-    void figureAdded(size_t index) {
+    void publish() {
+        if(!m_changed) {
+            return;
+        }
+
+        m_changed = false;
+        std::atomic_store(&m_published, m_state);
+    }
+
+    Slot& writableSlot(uint32_t index) {
+        return writableState().slots.writable(index);
+    }
+
+/*!
+Возвращает невладеющий указатель на графический примитив, хранимый в слоте
+\param figure графический примитив
+\return <i>std::shared_ptr<GraphicPrimitive::Figure></i>
+*/
+    static std::shared_ptr<GraphicPrimitive::Figure> borrowFigure(GraphicPrimitive::FigureValue& figure) {
+        return std::shared_ptr<GraphicPrimitive::Figure>(std::shared_ptr<GraphicPrimitive::Figure>(), &GraphicPrimitive::asFigure(figure));
+    }
+
+/*!
+Возвращает невладеющий указатель только для чтения на графический примитив, хранимый в слоте или снимке
+\param figure графический примитив
+\return <i>std::shared_ptr<const GraphicPrimitive::Figure></i>
+*/
+    static std::shared_ptr<const GraphicPrimitive::Figure> borrowFigure(const GraphicPrimitive::FigureValue& figure) {
+        return std::shared_ptr<const GraphicPrimitive::Figure>(std::shared_ptr<const GraphicPrimitive::Figure>(), &GraphicPrimitive::asFigure(figure));
+    }
+
+/*!
+Возвращает невладеющий указатель на общий невалидный графический примитив
+\return <i>std::shared_ptr<GraphicPrimitive::Figure></i>
+*/
+    static std::shared_ptr<GraphicPrimitive::Figure> invalidFigure() {
+        static GraphicPrimitive::InvalidFigure invalid;
+        return std::shared_ptr<GraphicPrimitive::Figure>(std::shared_ptr<GraphicPrimitive::Figure>(), &invalid);
+    }
+
+/*!
+Освобождает слот, идентификаторы удаленного примитива становятся недействительными
+\param slot номер слота
+\return <i>void</i>
+*/
+    void releaseSlot(uint32_t index) {
+        auto& released = writableSlot(index);
+        released.figure = GraphicPrimitive::InvalidFigure();
+        released.used = false;
+        released.generation++;
+        released.nextFree = m_freeSlot;
+        m_freeSlot = index;
+    }
+
+/*!
+Помещает графический примитив в свободный слот и добавляет его в конец порядка отрисовки
+\param figure графический примитив
+\return <i>FigureHandle</i>
+*/
+    FigureHandle insertFigure(GraphicPrimitive::FigureValue&& figure) {
+        auto& state = writableState();
+        uint32_t index = m_freeSlot;
+        if(index == NoSlot) {
+            index = uint32_t(state.slots.size());
+            state.slots.push_back({});
+        }
+        else {
+            m_freeSlot = slot(index).nextFree;
+        }
+
+        auto& inserted = state.slots.writable(index);
+        inserted.figure = std::move(figure);
+        inserted.nextFree = NoSlot;
+        inserted.used = true;
+        state.order.push_back(index);
+        m_positions.resize(state.slots.size());
+        m_positions[index] = uint32_t(state.order.size() - 1);
+        return {index, inserted.generation};
+    }
+
+/*!
+Обновляет хранимые индексы слотов, сдвинутых удалением. Стоит столько же, сколько сам сдвиг порядка отрисовки
+\param first первый индекс порядка отрисовки, начиная с которого примитивы сдвинулись
+\return <i>void</i>
+*/
+    void updatePositions(size_t first) {
+        m_state->order.forEach(first, [this](size_t index, uint32_t slot) {
+            m_positions[slot] = uint32_t(index);
+        });
+    }
+
+/*!
+Публикует версию и вызывает callback-и на добавление диапазона графических примитивов, внутри пакета только накапливает диапазон
+\param first индекс первого графического примитива
+\param count количество графических примитивов
+\return <i>void</i>
+*/
+    void figuresAdded(size_t first, size_t count) {
+        if(m_batchDepth > 0) {
+            m_pendingAddedCount += count;
+            return;
+        }
+
+        publish();
         for(auto& callback : m_figureAddedCallbacks) {
-            callback.second(index);
+            callback.second(first, count);
         }
     }
 
 /*!
-Вызывает callback-и на удаление графического примитива
-\param index индекс графического примитива
+Вызывает callback-и на добавление для примитивов, накопленных внутри пакета
+\return <i>void</i>
+*/
+    void flushPendingAdded() {
+        if(m_pendingAddedCount == 0) {
+            return;
+        }
+
+        auto count = m_pendingAddedCount;
+        m_pendingAddedCount = 0;
+        if(m_batchDepth == 0) {
+            publish();
+        }
+        for(auto& callback : m_figureAddedCallbacks) {
+            callback.second(m_state->order.size() - count, count);
+        }
+    }
+
+/*!
+Публикует версию (вне пакета) и вызывает callback-и на удаление диапазона графических примитивов
+\param first индекс первого графического примитива
+\param count количество графических примитивов
 \return <i>void</i>
 */
-    void figureRemoved(size_t index) {
+    void figuresRemoved(size_t first, size_t count) {
+        if(m_batchDepth == 0) {
+            publish();
+        }
         for(auto& callback : m_figureRemovedCallbacks) {
-            callback.second(index);
+            callback.second(first, count);
         }
     }
 };
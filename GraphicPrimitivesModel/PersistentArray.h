@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <memory_resource>
+#include <algorithm>
+
+namespace Model {
+
+/*!
+\brief Массив с разделяемыми узлами
+
+Элементы хранятся в листах по 2^LeafBits элементов, листы собираются в каталоги по 64 листа. Копия массива копирует только
+верхний уровень и разделяет с оригиналом все каталоги и листы. Изменение элемента копирует его каталог и лист,
+только если они разделяются с другой копией, поэтому изменение после копирования стоит O(размер листа), а не O(n).
+Узлы выделяются из переданного источника памяти
+*/
+template<typename T, size_t LeafBits>
+class PersistentArray {
+    static constexpr size_t LeafSize = size_t(1) << LeafBits;
+    static constexpr size_t DirectoryBits = 6;
+    static constexpr size_t DirectorySize = size_t(1) << DirectoryBits;
+
+    /// Лист: непрерывный блок элементов
+    struct Leaf {
+        std::array<T, LeafSize> items;
+    };
+
+    /// Каталог листов
+    struct Directory {
+        std::array<std::shared_ptr<Leaf>, DirectorySize> leaves;
+    };
+
+    std::pmr::vector<std::shared_ptr<Directory>> m_directories;
+    size_t m_size = 0;
+
+public:
+    explicit PersistentArray(std::pmr::memory_resource* resource) : m_directories(resource) {
+
+    }
+
+    PersistentArray(const PersistentArray& other) :
+        m_directories(other.m_directories, other.m_directories.get_allocator()),
+        m_size(other.m_size)
+    {
+
+    }
+
+    PersistentArray& operator=(const PersistentArray&) = delete;
+
+    size_t size() const {
+        return m_size;
+    }
+
+    const T& operator[](size_t index) const {
+        return m_directories[index >> (LeafBits + DirectoryBits)]->leaves[(index >> LeafBits) & (DirectorySize - 1)]->items[index & (LeafSize - 1)];
+    }
+
+/*!
+Возвращает элемент для изменения, копирует его каталог и лист, если они разделяются с другой копией массива
+\param index индекс элемента
+\return <i>T&</i>
+*/
+    T& writable(size_t index) {
+        auto& directory = detach(m_directories[index >> (LeafBits + DirectoryBits)]);
+        return detach(directory.leaves[(index >> LeafBits) & (DirectorySize - 1)]).items[index & (LeafSize - 1)];
+    }
+
+/*!
+Вызывает функцию для элементов, начиная с индекса, по порядку. Каждый лист проходится одним непрерывным блоком
+\param first индекс первого элемента
+\param function вызываемый объект с параметрами (индекс, элемент)
+\return <i>void</i>
+*/
+    template<typename Function>
+    void forEach(size_t first, Function function) const {
+        for(size_t index = first; index < m_size; ) {
+            size_t length = std::min(LeafSize - (index & (LeafSize - 1)), m_size - index);
+            const T* items = &(*this)[index];
+            for(size_t i = 0; i < length; i++) {
+                function(index + i, items[i]);
+            }
+            index += length;
+        }
+    }
+
+/*!
+Добавляет элемент в конец массива
+\param value элемент
+\return <i>void</i>
+*/
+    void push_back(T value) {
+        if((m_size & (LeafSize - 1)) == 0) {
+            if((m_size & (LeafSize * DirectorySize - 1)) == 0) {
+                m_directories.push_back(make<Directory>());
+            }
+            detach(m_directories.back()).leaves[(m_size >> LeafBits) & (DirectorySize - 1)] = make<Leaf>();
+        }
+        writable(m_size++) = std::move(value);
+    }
+
+/*!
+Удаляет диапазон элементов, следующие элементы сдвигаются к началу диапазона частями, не пересекающими границы листов
+\param first индекс первого удаляемого элемента
+\param count количество удаляемых элементов
+\return <i>void</i>
+*/
+    void erase(size_t first, size_t count) {
+        size_t to = first;
+        for(size_t from = first + count; from < m_size; ) {
+            size_t length = std::min({LeafSize - (to & (LeafSize - 1)), LeafSize - (from & (LeafSize - 1)), m_size - from});
+            const T* source = &(*this)[from];
+            std::copy(source, source + length, &writable(to));
+            to += length;
+            from += length;
+        }
+        shrink(m_size - count);
+    }
+
+private:
+    template<typename Node>
+    std::shared_ptr<Node> make() const {
+        return std::allocate_shared<Node>(std::pmr::polymorphic_allocator<Node>(m_directories.get_allocator().resource()));
+    }
+
+    template<typename Node>
+    Node& detach(std::shared_ptr<Node>& node) {
+        if(node.use_count() > 1) {
+            node = std::allocate_shared<Node>(std::pmr::polymorphic_allocator<Node>(m_directories.get_allocator().resource()), *node);
+        }
+        return *node;
+    }
+
+/*!
+Уменьшает размер массива, освобождает листы и каталоги за новым концом
+\param size новый размер
+\return <i>void</i>
+*/
+    void shrink(size_t size) {
+        size_t leaves = (size + LeafSize - 1) >> LeafBits;
+        size_t usedLeaves = (m_size + LeafSize - 1) >> LeafBits;
+        m_directories.resize((leaves + DirectorySize - 1) >> DirectoryBits);
+        for(size_t leaf = leaves; leaf < usedLeaves && (leaf >> DirectoryBits) < m_directories.size(); leaf++) {
+            detach(m_directories[leaf >> DirectoryBits]).leaves[leaf & (DirectorySize - 1)].reset();
+        }
+        m_size = size;
+    }
+};
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory_resource>
+#include <mutex>
+#include <algorithm>
+#include <cstddef>
+
+namespace Project {
+
+/*!
+\brief Статистика памяти арены проекта
+*/
+struct ArenaStatistics {
+    size_t bytesInUse = 0;    ///< байт выделено контейнерам проекта в данный момент
+    size_t highWaterMark = 0; ///< наибольшее значение <i>bytesInUse</i> за время жизни арены
+    size_t bytesReserved = 0; ///< байт получено ареной из глобальной кучи
+    double fragmentation = 0; ///< доля полученной памяти, не занятая контейнерами проекта
+};
+
+/*!
+\brief Арена памяти проекта
+
+Источник памяти для модели, представления и контролера одного проекта. Мелкие блоки раздаются из пулов по размерным классам,
+пулы получают память из глобальной кучи крупными порциями. У каждого проекта своя арена, поэтому разные проекты не конкурируют
+за общую кучу. Арена защищена собственным мьютексом: проект изменяется из одного потока, но снимки модели могут освобождаться
+в фоновых потоках сохранения и отрисовки. При разрушении арены память проекта возвращается в глобальную кучу крупными порциями пулов,
+а не по одному блоку, поэтому эта часть закрытия проекта не зависит от количества примитивов. Деструкторы контейнеров модели,
+представления и контролера при этом по-прежнему обходят свои элементы, так что закрытие проекта в целом линейно по его размеру
+*/
+class ProjectArena : public std::pmr::memory_resource {
+    /// Источник памяти, считающий байты, полученные из глобальной кучи
+    class CountingResource : public std::pmr::memory_resource {
+        std::pmr::memory_resource* m_upstream;
+        size_t m_bytes = 0;
+
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream) : m_upstream(upstream) {
+
+        }
+
+        size_t bytes() const {
+            return m_bytes;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* pointer = m_upstream->allocate(bytes, alignment);
+            m_bytes += bytes;
+            return pointer;
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+            m_upstream->deallocate(pointer, bytes, alignment);
+            m_bytes -= bytes;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    CountingResource m_upstream;
+    std::pmr::unsynchronized_pool_resource m_pools;
+    mutable std::mutex m_mutex;
+    size_t m_bytesInUse = 0;
+    size_t m_highWaterMark = 0;
+
+public:
+    explicit ProjectArena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+        m_upstream(upstream),
+        m_pools(&m_upstream)
+    {
+
+    }
+
+    ProjectArena(const ProjectArena&) = delete;
+    ProjectArena& operator=(const ProjectArena&) = delete;
+
+/*!
+Возвращает статистику использования памяти арены
+\return <i>ArenaStatistics</i>
+*/
+    ArenaStatistics statistics() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ArenaStatistics statistics;
+        statistics.bytesInUse = m_bytesInUse;
+        statistics.highWaterMark = m_highWaterMark;
+        statistics.bytesReserved = m_upstream.bytes();
+        if(statistics.bytesReserved > 0) {
+            statistics.fragmentation = 1.0 - double(std::min(m_bytesInUse, statistics.bytesReserved)) / double(statistics.bytesReserved);
+        }
+        return statistics;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        void* pointer = m_pools.allocate(bytes, alignment);
+        m_bytesInUse += bytes;
+        m_highWaterMark = std::max(m_highWaterMark, m_bytesInUse);
+        return pointer;
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pools.deallocate(pointer, bytes, alignment);
+        m_bytesInUse -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+}
@@ -0,0 +1,527 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <array>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "GraphicPrimitivesModel/GraphicPrimitivesModel.h"
+
+namespace Project {
+
+/*!
+\brief Бинарный формат файла проекта
+
+Файл состоит из заголовка с размерами холста, таблицы секций и самих секций. Секция порядка содержит тип каждого графического
+примитива в порядке отрисовки, остальные секции содержат записи фиксированного размера для одного типа примитивов.
+Все записи выровнены на 8 байт и читаются на месте из отображенного в память файла, без разбора текста. При загрузке в модель
+каждая запись проверяется и копируется в графический примитив фиксированного размера. Контрольная сумма в заголовке покрывает
+весь файл, поэтому оборванный или поврежденный файл не открывается
+*/
+namespace ProjectFile {
+
+constexpr char Magic[4] = {'H', 'T', '5', 'P'}; ///< сигнатура файла проекта
+constexpr uint32_t Version = 2;                 ///< версия формата
+constexpr uint32_t OrderSection = 0;            ///< тип секции порядка отрисовки
+constexpr uint32_t SectionCount = 6;            ///< секция порядка и по одной секции на тип примитива
+
+/// Заголовок файла проекта
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint64_t figureCount;
+    uint32_t sectionCount;
+    uint32_t journalGeneration; ///< поколение журнала изменений, которое применяется поверх файла
+    uint64_t checksum;          ///< контрольная сумма всего файла, вычисленная с нулевым значением этого поля
+};
+
+/// Описание секции файла проекта
+struct SectionHeader {
+    uint32_t type;       ///< OrderSection или значение GraphicPrimitive::FigureType
+    uint32_t recordSize; ///< размер одной записи в байтах
+    uint64_t count;      ///< количество записей
+    uint64_t offset;     ///< смещение секции от начала файла
+};
+
+/// Параметры кисти и заливки в записи
+struct StyleRecord {
+    uint32_t penColor;
+    uint32_t brushColor;
+    float penWidth;
+    uint8_t penType;
+    uint8_t brushType;
+    uint8_t reserved[2];
+};
+
+/// Запись графического примитива: четыре координаты и параметры кисти и заливки
+struct FigureRecord {
+    double a;
+    double b;
+    double c;
+    double d;
+    StyleRecord style;
+};
+
+static_assert(sizeof(FileHeader) == 40, "FileHeader layout");
+static_assert(sizeof(SectionHeader) == 24, "SectionHeader layout");
+static_assert(sizeof(FigureRecord) == 48, "FigureRecord layout");
+
+/*!
+Возвращает номер секции для типа графического примитива, 0 для невалидного
+\param type тип графического примитива
+\return <i>size_t</i>
+*/
+inline size_t sectionOf(GraphicPrimitive::FigureType type) {
+    return size_t(type) < SectionCount ? size_t(type) : 0;
+}
+
+/*!
+Продолжает контрольную сумму данными: FNV-1a по 64-битным словам. Все части файла проекта кратны 8 байтам,
+поэтому сумма считается по словам, а не по байтам
+\param data данные, размер кратен 8 байтам
+\param size размер данных в байтах
+\param hash контрольная сумма предыдущих данных
+\return <i>uint64_t</i>
+*/
+inline uint64_t checksum(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+
+inline StyleRecord encodeStyle(const GraphicPrimitive::Figure& figure, uint32_t brushColor, GraphicPrimitive::BrushType brushType) {
+    return {figure.penColor(), brushColor, figure.penWidth(), uint8_t(figure.penType()), uint8_t(brushType), {0, 0}};
+}
+
+inline FigureRecord encode(const GraphicPrimitive::InvalidFigure&) {
+    return {};
+}
+
+inline FigureRecord encode(const GraphicPrimitive::Line& line) {
+    return {line.p1().x, line.p1().y, line.p2().x, line.p2().y, encodeStyle(line, 0, GraphicPrimitive::BrushType::None)};
+}
+
+inline FigureRecord encode(const GraphicPrimitive::Rectangle& rectangle) {
+    return {rectangle.corner().x, rectangle.corner().y, rectangle.width(), rectangle.height(), encodeStyle(rectangle, rectangle.brushColor(), rectangle.brushType())};
+}
+
+inline FigureRecord encode(const GraphicPrimitive::Circle& circle) {
+    return {circle.center().x, circle.center().y, circle.radius(), circle.radius(), encodeStyle(circle, circle.brushColor(), circle.brushType())};
+}
+
+inline FigureRecord encode(const GraphicPrimitive::Square& square) {
+    return {square.corner().x, square.corner().y, square.width(), square.width(), encodeStyle(square, square.brushColor(), square.brushType())};
+}
+
+inline FigureRecord encode(const GraphicPrimitive::Ellipse& ellipse) {
+    return {ellipse.center().x, ellipse.center().y, ellipse.radiusX(), ellipse.radiusY(), encodeStyle(ellipse, ellipse.brushColor(), ellipse.brushType())};
+}
+
+/*!
+Возвращает <i>true</i>, если значения записи допустимы: типы кисти и заливки входят в свои перечисления, а координаты
+и толщина кисти конечны. Художник выбирает узоры кисти и заливки из таблиц по типу, поэтому значения из файла
+приводятся к перечислениям только после проверки
+\param record запись
+\return <i>bool</i>
+*/
+inline bool isValid(const FigureRecord& record) {
+    return record.style.penType <= uint8_t(GraphicPrimitive::PenType::Dot) &&
+           record.style.brushType <= uint8_t(GraphicPrimitive::BrushType::Vertical) &&
+           std::isfinite(record.a) && std::isfinite(record.b) && std::isfinite(record.c) && std::isfinite(record.d) &&
+           std::isfinite(record.style.penWidth);
+}
+
+/*!
+Восстанавливает графический примитив из записи. Неизвестный тип и недопустимая запись дают невалидный примитив
+\param type тип графического примитива, как он записан в файле
+\param record запись
+\return <i>GraphicPrimitive::FigureValue</i>
+*/
+inline GraphicPrimitive::FigureValue decode(uint32_t type, const FigureRecord& record) {
+    using namespace GraphicPrimitive;
+    if(type == OrderSection || type >= SectionCount || !isValid(record)) {
+        return InvalidFigure();
+    }
+
+    auto penType = PenType(record.style.penType);
+    auto brushType = BrushType(record.style.brushType);
+    const auto& style = record.style;
+
+    switch (FigureType(type)) {
+    case FigureType::Line:
+        return Line({record.a, record.b}, {record.c, record.d}, style.penColor, penType, style.penWidth);
+    case FigureType::Rectangle:
+        return Rectangle({record.a, record.b}, float(record.c), float(record.d), style.penColor, penType, style.penWidth, style.brushColor, brushType);
+    case FigureType::Circle:
+        return Circle({record.a, record.b}, float(record.c), style.penColor, penType, style.penWidth, style.brushColor, brushType);
+    case FigureType::Square:
+        return Square({record.a, record.b}, float(record.c), style.penColor, penType, style.penWidth, style.brushColor, brushType);
+    case FigureType::Ellipse:
+        return Ellipse({record.a, record.b}, float(record.c), float(record.d), style.penColor, penType, style.penWidth, style.brushColor, brushType);
+    default:
+        return InvalidFigure();
+    }
+}
+
+/*!
+Сохраняет проект в файл. Записи раскладываются по секциям в памяти, затем каждая секция пишется одной операцией записи.
+Файл сначала пишется во временный файл и затем переименовывается, поэтому прежняя версия не повреждается при сбое
+\param fileName имя файла проекта
+\param width ширина холста
+\param height высота холста
+\param count количество графических примитивов
+\param figureAt функция, возвращающая графический примитив по индексу
+\param journalGeneration поколение журнала изменений
+\return <i>bool</i>
+*/
+template<typename FigureAt>
+bool save(const std::string& fileName, uint32_t width, uint32_t height, size_t count, FigureAt figureAt, uint32_t journalGeneration = 0) {
+    std::vector<uint8_t> order((count + 7) & ~size_t(7));
+    std::array<std::vector<FigureRecord>, SectionCount> records;
+
+    for(size_t i = 0; i < count; i++) {
+        const GraphicPrimitive::FigureValue& figure = figureAt(i);
+        auto section = sectionOf(GraphicPrimitive::asFigure(figure).type());
+        order[i] = uint8_t(section);
+        if(section == OrderSection) {
+            continue;
+        }
+        records[section].push_back(std::visit([](const auto& value) { return encode(value); }, figure));
+    }
+
+    FileHeader header = {{Magic[0], Magic[1], Magic[2], Magic[3]}, Version, width, height, count, SectionCount, journalGeneration, 0};
+    std::array<SectionHeader, SectionCount> sections;
+    uint64_t offset = sizeof(FileHeader) + sizeof(SectionHeader) * SectionCount;
+
+    sections[OrderSection] = {OrderSection, 1, count, offset};
+    offset += order.size();
+    for(uint32_t section = 1; section < SectionCount; section++) {
+        sections[section] = {section, sizeof(FigureRecord), records[section].size(), offset};
+        offset += records[section].size() * sizeof(FigureRecord);
+    }
+
+    uint64_t hash = checksum(&header, sizeof(header));
+    hash = checksum(sections.data(), sizeof(SectionHeader) * SectionCount, hash);
+    hash = checksum(order.data(), order.size(), hash);
+    for(uint32_t section = 1; section < SectionCount; section++) {
+        hash = checksum(records[section].data(), records[section].size() * sizeof(FigureRecord), hash);
+    }
+    header.checksum = hash;
+
+    std::string temporaryName = fileName + ".tmp";
+    FILE* file = std::fopen(temporaryName.c_str(), "wb");
+    if(!file) {
+        return false;
+    }
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(sections.data(), sizeof(SectionHeader), SectionCount, file) == SectionCount &&
+                   (order.empty() || std::fwrite(order.data(), 1, order.size(), file) == order.size());
+
+    for(uint32_t section = 1; written && section < SectionCount; section++) {
+        written = records[section].empty() ||
+                  std::fwrite(records[section].data(), sizeof(FigureRecord), records[section].size(), file) == records[section].size();
+    }
+
+    written = std::fflush(file) == 0 && written;
+#if defined(__unix__) || defined(__APPLE__)
+    written = ::fsync(fileno(file)) == 0 && written;
+#endif
+    written = std::fclose(file) == 0 && written;
+
+    if(!written) {
+        std::remove(temporaryName.c_str());
+        return false;
+    }
+
+    return std::rename(temporaryName.c_str(), fileName.c_str()) == 0;
+}
+
+/*!
+Сохраняет модель в файл проекта
+\param fileName имя файла проекта
+\param width ширина холста
+\param height высота холста
+\param model модель графических примитивов
+\param journalGeneration поколение журнала изменений
+\return <i>bool</i>
+*/
+inline bool save(const std::string& fileName, uint32_t width, uint32_t height, const Model::GraphicPrimitivesModel& model, uint32_t journalGeneration = 0) {
+    return save(fileName, width, height, model.count(), [&model](size_t i) -> const GraphicPrimitive::FigureValue& { return model.figure(i); }, journalGeneration);
+}
+
+/*!
+Сохраняет снимок модели в файл проекта. Может выполняться в фоновом потоке, пока модель изменяется
+\param fileName имя файла проекта
+\param width ширина холста
+\param height высота холста
+\param snapshot снимок модели графических примитивов
+\param journalGeneration поколение журнала изменений
+\return <i>bool</i>
+*/
+inline bool save(const std::string& fileName, uint32_t width, uint32_t height, const Model::GraphicPrimitivesModel::Snapshot& snapshot, uint32_t journalGeneration = 0) {
+    return save(fileName, width, height, snapshot.count(), [&snapshot](size_t i) -> const GraphicPrimitive::FigureValue& { return snapshot.figure(i); }, journalGeneration);
+}
+
+/*!
+\brief Файл, отображенный в память только для чтения
+
+На POSIX-системах используется <i>mmap</i>, на остальных файл читается в буфер целиком
+*/
+class MappedFile {
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    std::vector<uint8_t> m_buffer;
+
+public:
+    MappedFile() {
+
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+/*!
+Отображает файл в память, возвращает <i>true</i> при успехе
+\param fileName имя файла
+\return <i>bool</i>
+*/
+    bool open(const std::string& fileName) {
+        close();
+
+#if defined(__unix__) || defined(__APPLE__)
+        int descriptor = ::open(fileName.c_str(), O_RDONLY);
+        if(descriptor < 0) {
+            return false;
+        }
+
+        struct stat status;
+        if(::fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+            ::close(descriptor);
+            return false;
+        }
+
+        void* data = ::mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if(data == MAP_FAILED) {
+            return false;
+        }
+
+        ::madvise(data, size_t(status.st_size), MADV_SEQUENTIAL);
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = size_t(status.st_size);
+        return true;
+#else
+        FILE* file = std::fopen(fileName.c_str(), "rb");
+        if(!file) {
+            return false;
+        }
+
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if(size > 0) {
+            m_buffer.resize(size_t(size));
+            if(std::fread(m_buffer.data(), 1, m_buffer.size(), file) != m_buffer.size()) {
+                m_buffer.clear();
+            }
+        }
+        std::fclose(file);
+
+        m_data = m_buffer.empty() ? nullptr : m_buffer.data();
+        m_size = m_buffer.size();
+        return m_data != nullptr;
+#endif
+    }
+
+/*!
+Снимает отображение файла
+\return <i>void</i>
+*/
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if(m_data) {
+            ::munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_buffer.clear();
+    }
+
+    const uint8_t* data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+};
+
+/*!
+\brief Чтение файла проекта
+
+Проверяет заголовок и таблицу секций, затем выдает графические примитивы в порядке отрисовки. Для каждой секции хранится курсор,
+поэтому примитивы можно читать частями
+*/
+class Reader {
+    MappedFile m_file;
+    const FileHeader* m_header = nullptr;
+    std::array<const SectionHeader*, SectionCount> m_sections = {};
+    std::array<uint64_t, SectionCount> m_cursors = {};
+    uint64_t m_position = 0;
+
+public:
+/*!
+Открывает файл проекта, возвращает <i>true</i> если файл корректен. Проверка контрольной суммы читает весь файл,
+поэтому ее можно отложить и выполнить позже через <i>verify()</i>, например в фоновой задаче
+\param fileName имя файла проекта
+\param verifyChecksum проверить контрольную сумму при открытии
+\return <i>bool</i>
+*/
+    bool open(const std::string& fileName, bool verifyChecksum = true) {
+        m_header = nullptr;
+        if(!m_file.open(fileName) || m_file.size() < sizeof(FileHeader)) {
+            return false;
+        }
+
+        auto header = reinterpret_cast<const FileHeader*>(m_file.data());
+        if(std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version || header->sectionCount != SectionCount ||
+           m_file.size() < sizeof(FileHeader) + sizeof(SectionHeader) * SectionCount) {
+            return false;
+        }
+
+        auto sections = reinterpret_cast<const SectionHeader*>(m_file.data() + sizeof(FileHeader));
+        for(uint32_t section = 0; section < SectionCount; section++) {
+            const auto& description = sections[section];
+            uint32_t recordSize = section == OrderSection ? 1 : sizeof(FigureRecord);
+            if(description.type != section || description.recordSize != recordSize ||
+               (section != OrderSection && description.offset % alignof(FigureRecord) != 0) ||
+               description.offset > m_file.size() || description.count > (m_file.size() - description.offset) / recordSize) {
+                return false;
+            }
+            m_sections[section] = &description;
+        }
+
+        if(m_sections[OrderSection]->count != header->figureCount) {
+            return false;
+        }
+
+        m_header = header;
+        if(verifyChecksum && !verify()) {
+            m_header = nullptr;
+            return false;
+        }
+
+        rewind();
+        return true;
+    }
+
+/*!
+Возвращает <i>true</i>, если контрольная сумма открытого файла совпадает с записанной в заголовке
+\return <i>bool</i>
+*/
+    bool verify() const {
+        if(!m_header || m_file.size() % sizeof(uint64_t) != 0) {
+            return false;
+        }
+
+        FileHeader header = *m_header;
+        header.checksum = 0;
+        uint64_t hash = checksum(&header, sizeof(header));
+        hash = checksum(m_file.data() + sizeof(FileHeader), m_file.size() - sizeof(FileHeader), hash);
+        return hash == m_header->checksum;
+    }
+
+    uint32_t width() const {
+        return m_header ? m_header->width : 0;
+    }
+
+    uint32_t height() const {
+        return m_header ? m_header->height : 0;
+    }
+
+/*!
+Возвращает поколение журнала изменений, который применяется поверх файла
+\return <i>uint32_t</i>
+*/
+    uint32_t journalGeneration() const {
+        return m_header ? m_header->journalGeneration : 0;
+    }
+
+/*!
+Возвращает общее количество графических примитивов в файле
+\return <i>size_t</i>
+*/
+    size_t count() const {
+        return m_header ? size_t(m_header->figureCount) : 0;
+    }
+
+/*!
+Возвращает количество уже прочитанных графических примитивов
+\return <i>size_t</i>
+*/
+    size_t position() const {
+        return size_t(m_position);
+    }
+
+/*!
+Возвращает чтение к первому графическому примитиву
+\return <i>void</i>
+*/
+    void rewind() {
+        m_cursors.fill(0);
+        m_position = 0;
+    }
+
+/*!
+Читает следующие графические примитивы в порядке отрисовки и добавляет их в конец контейнера, возвращает количество прочитанных.
+Вместо недопустимых записей добавляются невалидные примитивы, поэтому индексы остальных примитивов сохраняются
+\param figures контейнер, в который добавляются примитивы
+\param maxCount наибольшее количество примитивов
+\return <i>size_t</i>
+*/
+    size_t read(std::vector<GraphicPrimitive::FigureValue>& figures, size_t maxCount = std::numeric_limits<size_t>::max()) {
+        if(!m_header) {
+            return 0;
+        }
+
+        auto order = m_file.data() + m_sections[OrderSection]->offset;
+        size_t readCount = 0;
+        for(; readCount < maxCount && m_position < m_header->figureCount; readCount++, m_position++) {
+            uint8_t section = order[m_position];
+            if(section == OrderSection || section >= SectionCount || m_cursors[section] >= m_sections[section]->count) {
+                figures.emplace_back(GraphicPrimitive::InvalidFigure());
+                continue;
+            }
+
+            auto records = reinterpret_cast<const FigureRecord*>(m_file.data() + m_sections[section]->offset);
+            figures.push_back(decode(section, records[m_cursors[section]++]));
+        }
+        return readCount;
+    }
+};
+
+}
+
+}
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <future>
+#include <fstream>
+#include <filesystem>
+
+#include "Scheduler/JobScheduler.h"
+#include "ProjectFile.h"
+
+namespace Project {
+
+/*!
+\brief Журнал изменений проекта
+
+Записывает добавления и удаления графических примитивов с момента последнего сохранения. Сохранение дописывает в файл журнала
+только накопленные изменения и выполняет <i>fsync</i>, поэтому его длительность зависит от размера правки, а не документа.
+Когда журнал становится длиннее порога, в фоне записывается полный снимок следующего поколения и журнал начинается заново.
+
+Файлы журнала называются <i>имя_проекта.journal.N</i>, где N - поколение. Снимок хранит поколение журнала, который к нему применяется.
+При сбое во время сжатия снимок остается прежнего поколения, и при загрузке применяются журналы всех последующих поколений.
+Каждая запись журнала защищена контрольной суммой, запись, оборванная сбоем, и все после нее отбрасываются.
+
+Журнал владеет только файлом проекта, который он загрузил (<i>open()</i>) или записал сам. Изменения дописываются к такому файлу,
+только когда модель содержит его целиком: до завершения <i>replay()</i> сохранение в этот файл не выполняется. Полный снимок
+в другой файл не записывается поверх существующего файла, поэтому чужой или непрочитанный файл не перезаписывается
+*/
+class ProjectJournal {
+public:
+    static constexpr size_t DefaultCompactionThreshold = 16 * 1024; ///< количество записей журнала, после которого выполняется сжатие
+
+private:
+    static constexpr char Magic[4] = {'H', 'T', '5', 'J'};
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t FrameMarker = 0x4A355448;
+
+    /// Операция над моделью
+    enum class Operation : uint32_t {
+        Add = 1,   ///< добавление графического примитива в конец модели
+        Remove = 2 ///< удаление диапазона графических примитивов
+    };
+
+    /// Запись журнала
+    struct Entry {
+        Operation operation;
+        uint32_t type;
+        uint64_t index;
+        uint64_t count;
+        ProjectFile::FigureRecord record;
+    };
+
+    /// Запись журнала в файле вместе с маркером и контрольной суммой
+    struct Frame {
+        uint32_t marker;
+        uint32_t checksum;
+        Entry entry;
+    };
+
+    /// Заголовок файла журнала
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t generation;
+    };
+
+    Model::GraphicPrimitivesModel* m_model = nullptr;
+    size_t m_addConnectedIndex = 0;
+    size_t m_removedConnectedIndex = 0;
+
+    std::string m_fileName;    ///< файл проекта, который журнал загрузил или записал, пустой если такого нет
+    uint32_t m_generation = 0;
+    size_t m_journalEntries = 0;
+    bool m_complete = true;    ///< модель содержит файл проекта целиком вместе с журналами
+    bool m_recording = true;
+    std::vector<Entry> m_pending;
+    size_t m_compactionThreshold = DefaultCompactionThreshold;
+    std::future<bool> m_compaction;
+    Scheduler::JobScheduler* m_scheduler = nullptr;
+
+public:
+    ProjectJournal() {
+
+    }
+
+    ProjectJournal(const ProjectJournal&) = delete;
+    ProjectJournal& operator=(const ProjectJournal&) = delete;
+
+    ~ProjectJournal() {
+        waitForCompaction();
+        detach();
+    }
+
+/*!
+Подключает журнал к модели, с этого момента изменения модели записываются
+\param model модель
+\return <i>void</i>
+*/
+    void attach(Model::GraphicPrimitivesModel& model) {
+        detach();
+        m_model = &model;
+        m_addConnectedIndex = m_model->connectToAddFigures([this](size_t first, size_t count) { figuresAdded(first, count); });
+        m_removedConnectedIndex = m_model->connectToRemoveFigures([this](size_t first, size_t count) { figuresRemoved(first, count); });
+    }
+
+/*!
+Отключает журнал от модели
+\return <i>void</i>
+*/
+    void detach() {
+        if(!m_model) {
+            return;
+        }
+
+        m_model->disconnectToAddFigure(m_addConnectedIndex);
+        m_model->disconnectToRemoveFigure(m_removedConnectedIndex);
+        m_model = nullptr;
+    }
+
+/*!
+Возвращает <i>true</i>, если есть изменения, не записанные на диск
+\return <i>bool</i>
+*/
+    bool hasChanges() const {
+        return !m_pending.empty();
+    }
+
+/*!
+Устанавливает планировщик, на котором выполняется сжатие журнала. Без планировщика сжатие выполняется отдельным потоком
+\param scheduler планировщик задач
+\return <i>void</i>
+*/
+    void setScheduler(Scheduler::JobScheduler* scheduler) {
+        m_scheduler = scheduler;
+    }
+
+/*!
+Включает или отключает запись изменений модели, например на время потоковой загрузки
+\param recording записывать изменения
+\return <i>void</i>
+*/
+    void setRecording(bool recording) {
+        m_recording = recording;
+    }
+
+/*!
+Устанавливает количество записей журнала, после которого выполняется сжатие в полный снимок
+\param threshold количество записей
+\return <i>void</i>
+*/
+    void setCompactionThreshold(size_t threshold) {
+        m_compactionThreshold = threshold;
+    }
+
+/*!
+Связывает журнал с файлом проекта, который загружается в модель. Вызывается по заголовку файла до загрузки примитивов:
+с этого момента файл принадлежит журналу, но изменения в него не сохраняются, пока <i>replay()</i> не применит журналы
+\param fileName имя файла проекта
+\param generation поколение журнала из заголовка снимка
+\return <i>void</i>
+*/
+    void open(const std::string& fileName, uint32_t generation) {
+        waitForCompaction();
+        m_fileName = fileName;
+        m_generation = generation;
+        m_journalEntries = 0;
+        m_complete = false;
+        m_pending.clear();
+    }
+
+/*!
+Применяет к модели журналы, записанные поверх снимка файла из <i>open()</i>, после чего изменения можно сохранять в этот файл.
+Изменения при применении не записываются. Оборванный сбоем хвост последнего журнала обрезается, чтобы новые записи
+следовали сразу за корректными
+\param model модель, в которую загружен весь снимок
+\return <i>void</i>
+*/
+    void replay(Model::GraphicPrimitivesModel& model) {
+        if(m_fileName.empty()) {
+            return;
+        }
+
+        bool recording = m_recording;
+        m_recording = false;
+        for(uint32_t current = m_generation; ; current++) {
+            std::vector<Entry> entries;
+            if(!readJournal(journalName(m_fileName, current), current, entries)) {
+                break;
+            }
+
+            m_generation = current;
+            m_journalEntries = entries.size();
+            apply(entries, model);
+        }
+
+        if(m_journalEntries > 0) {
+            std::error_code error;
+            std::filesystem::resize_file(journalName(m_fileName, m_generation), sizeof(Header) + m_journalEntries * sizeof(Frame), error);
+        }
+
+        m_recording = recording;
+        m_complete = true;
+    }
+
+/*!
+Возвращает <i>true</i>, если модель содержит файл проекта журнала целиком и изменения можно дописывать в этот файл.
+Для проекта без файла возвращает <i>true</i>
+\return <i>bool</i>
+*/
+    bool isComplete() const {
+        return m_complete;
+    }
+
+/*!
+Сохраняет изменения. В файл журнала дописываются только накопленные изменения, без изменений сохранение пропускается.
+В другой файл записывается полный снимок, только если такого файла еще нет. Возвращает <i>false</i> и ничего не пишет,
+если файл журнала загружен не целиком (загрузка не завершена или отменена) или другой файл уже существует
+\param fileName имя файла проекта
+\param width ширина холста
+\param height высота холста
+\return <i>bool</i>
+*/
+    bool save(const std::string& fileName, uint32_t width, uint32_t height) {
+        if(!m_model || fileName.empty()) {
+            return false;
+        }
+
+        if(fileName != m_fileName) {
+            return saveSnapshot(fileName, width, height);
+        }
+
+        if(!m_complete) {
+            return false;
+        }
+
+        if(m_pending.empty()) {
+            return true;
+        }
+
+        if(!appendJournal()) {
+            return false;
+        }
+
+        if(m_journalEntries >= m_compactionThreshold) {
+            startCompaction(width, height);
+        }
+        return true;
+    }
+
+/*!
+Дожидается завершения фонового сжатия журнала, возвращает <i>false</i> если сжатие не удалось
+\return <i>bool</i>
+*/
+    bool waitForCompaction() {
+        if(!m_compaction.valid()) {
+            return true;
+        }
+
+        return m_scheduler ? m_scheduler->wait(m_compaction) : m_compaction.get();
+    }
+
+/*!
+Возвращает имя файла журнала указанного поколения
+\param fileName имя файла проекта
+\param generation поколение журнала
+\return <i>std::string</i>
+*/
+    static std::string journalName(const std::string& fileName, uint32_t generation) {
+        return fileName + ".journal." + std::to_string(generation);
+    }
+
+private:
+    void figuresAdded(size_t first, size_t count) {
+        if(!m_recording) {
+            return;
+        }
+
+        for(size_t i = 0; i < count; i++) {
+            const auto& figure = m_model->figure(first + i);
+            Entry entry = {Operation::Add, uint32_t(GraphicPrimitive::asFigure(figure).type()), first + i, 1, {}};
+            entry.record = std::visit([](const auto& value) { return ProjectFile::encode(value); }, figure);
+            m_pending.push_back(entry);
+        }
+    }
+
+    void figuresRemoved(size_t first, size_t count) {
+        if(!m_recording) {
+            return;
+        }
+
+        m_pending.push_back({Operation::Remove, 0, first, count, {}});
+    }
+
+/*!
+Применяет записи журнала к модели, идущие подряд добавления переносятся в модель одним пакетом.
+Весь журнал применяется одним пакетом изменений модели и публикуется читателям одной версией.
+Добавления с недопустимой записью дают невалидный примитив, записи с неизвестной операцией и удаления за концом модели пропускаются
+\param entries записи журнала
+\param model модель
+\return <i>void</i>
+*/
+    static void apply(const std::vector<Entry>& entries, Model::GraphicPrimitivesModel& model) {
+        Model::GraphicPrimitivesModel::BatchGuard batch(model);
+        std::vector<GraphicPrimitive::FigureValue> added;
+        for(const auto& entry : entries) {
+            if(entry.operation == Operation::Add) {
+                added.push_back(ProjectFile::decode(entry.type, entry.record));
+                continue;
+            }
+
+            model.addFigures(added);
+            added.clear();
+            if(entry.operation != Operation::Remove || entry.index >= model.count()) {
+                continue;
+            }
+
+            std::vector<size_t> indices;
+            uint64_t count = std::min<uint64_t>(entry.count, model.count() - entry.index);
+            for(uint64_t i = 0; i < count; i++) {
+                indices.push_back(size_t(entry.index + i));
+            }
+            model.removeFigures(std::move(indices));
+        }
+        model.addFigures(added);
+    }
+
+/*!
+Вычисляет контрольную сумму FNV-1a записи журнала
+\param entry запись журнала
+\return <i>uint32_t</i>
+*/
+    static uint32_t checksum(const Entry& entry) {
+        auto bytes = reinterpret_cast<const uint8_t*>(&entry);
+        uint32_t hash = 2166136261u;
+        for(size_t i = 0; i < sizeof(Entry); i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+/*!
+Читает записи журнала до конца файла или до первой поврежденной записи, возвращает <i>false</i> если журнала нет
+\param fileName имя файла журнала
+\param generation ожидаемое поколение журнала
+\param entries прочитанные записи
+\return <i>bool</i>
+*/
+    static bool readJournal(const std::string& fileName, uint32_t generation, std::vector<Entry>& entries) {
+        std::ifstream file(fileName, std::ios::binary);
+        Header header;
+        if(!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+           std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.generation != generation) {
+            return false;
+        }
+
+        Frame frame;
+        while(file.read(reinterpret_cast<char*>(&frame), sizeof(frame))) {
+            if(frame.marker != FrameMarker || frame.checksum != checksum(frame.entry)) {
+                break;
+            }
+            entries.push_back(frame.entry);
+        }
+        return true;
+    }
+
+/*!
+Дописывает накопленные изменения в журнал текущего поколения и сбрасывает их на диск. Журнал нового поколения
+создается заново, поэтому файл, оставшийся от прежнего проекта с тем же именем, перезаписывается
+\return <i>bool</i>
+*/
+    bool appendJournal() {
+        auto fileName = journalName(m_fileName, m_generation);
+        FILE* file = std::fopen(fileName.c_str(), m_journalEntries == 0 ? "wb" : "ab");
+        if(!file) {
+            return false;
+        }
+
+        std::vector<Frame> frames;
+        frames.reserve(m_pending.size() + 1);
+        for(const auto& entry : m_pending) {
+            frames.push_back({FrameMarker, checksum(entry), entry});
+        }
+
+        bool written = true;
+        if(m_journalEntries == 0) {
+            Header header = {{Magic[0], Magic[1], Magic[2], Magic[3]}, Version, m_generation};
+            written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        }
+
+        written = written && std::fwrite(frames.data(), sizeof(Frame), frames.size(), file) == frames.size();
+        written = std::fflush(file) == 0 && written;
+#if defined(__unix__) || defined(__APPLE__)
+        written = ::fsync(fileno(file)) == 0 && written;
+#endif
+        written = std::fclose(file) == 0 && written;
+        if(!written) {
+            return false;
+        }
+
+        m_journalEntries += m_pending.size();
+        m_pending.clear();
+        return true;
+    }
+
+/*!
+Записывает полный снимок в новый файл проекта и удаляет журналы с тем же именем, оставшиеся от удаленного проекта.
+Существующий файл не перезаписывается: журнал его не загружал, и его содержимое было бы потеряно.
+После записи журнал владеет новым файлом
+\param fileName имя файла проекта
+\param width ширина холста
+\param height высота холста
+\return <i>bool</i>
+*/
+    bool saveSnapshot(const std::string& fileName, uint32_t width, uint32_t height) {
+        std::error_code error;
+        if(std::filesystem::exists(fileName, error) || error) {
+            return false;
+        }
+
+        waitForCompaction();
+        if(!ProjectFile::save(fileName, width, height, *m_model, 0)) {
+            return false;
+        }
+
+        for(uint32_t stale = 0; std::ifstream(journalName(fileName, stale)).good(); stale++) {
+            std::remove(journalName(fileName, stale).c_str());
+        }
+
+        m_fileName = fileName;
+        m_generation = 0;
+        m_journalEntries = 0;
+        m_complete = true;
+        m_pending.clear();
+        return true;
+    }
+
+/*!
+Запускает фоновое сжатие: снимок модели записывается файлом проекта следующего поколения, новые изменения
+сразу пишутся в журнал следующего поколения. После переименования файла журнал прежнего поколения удаляется.
+Снимок модели создается за O(1)
+\param width ширина холста
+\param height высота холста
+\return <i>void</i>
+*/
+    void startCompaction(uint32_t width, uint32_t height) {
+        waitForCompaction();
+
+        auto snapshot = m_model->snapshot();
+        auto fileName = m_fileName;
+        auto previousGeneration = m_generation;
+        m_generation++;
+        m_journalEntries = 0;
+
+        auto compact = [fileName, width, height, previousGeneration, snapshot = std::move(snapshot)]() {
+            if(!ProjectFile::save(fileName, width, height, snapshot, previousGeneration + 1)) {
+                return false;
+            }
+
+            std::remove(journalName(fileName, previousGeneration).c_str());
+            return true;
+        };
+
+        if(m_scheduler) {
+            m_compaction = m_scheduler->submit(std::move(compact), Scheduler::Priority::Background);
+        }
+        else {
+            m_compaction = std::async(std::launch::async, std::move(compact));
+        }
+    }
+};
+
+}
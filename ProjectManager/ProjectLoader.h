@@ -0,0 +1,247 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <deque>
+
+#include "Scheduler/JobScheduler.h"
+#include "ProjectFile.h"
+
+namespace Project {
+
+/*!
+\brief Потоковая загрузка файла проекта
+
+Заголовок файла читается сразу, поэтому размеры холста известны до загрузки примитивов. Примитивы читаются фоновыми задачами
+планировщика по одному пакету на задачу и складываются в ограниченную очередь, откуда их забирает поток, владеющий моделью.
+Когда очередь заполнена, чтение приостанавливается и возобновляется после того, как потребитель забрал пакет, поэтому рабочие
+потоки не блокируются. Без планировщика пакеты читаются при запросе. Первый пакет небольшой, поэтому время до первой отрисовки
+не зависит от размера файла. Контрольная сумма файла проверяется первой задачей чтения, до передачи первого пакета,
+чтобы не задерживать поток, открывающий проект. Загрузку можно отменить в любой момент
+*/
+class ProjectLoader {
+    /// Состояние, разделяемое с задачами чтения
+    struct Shared {
+        ProjectFile::Reader reader;
+        Scheduler::JobScheduler* scheduler = nullptr;
+        std::mutex mutex;
+        std::deque<std::vector<GraphicPrimitive::FigureValue>> batches;
+        std::atomic<size_t> loaded = 0;
+        std::atomic<bool> cancelled = false;
+        bool reading = false;  ///< задача чтения поставлена или выполняется
+        bool finished = false;
+        bool verified = false; ///< контрольная сумма проверена, читается только задачами чтения
+        bool failed = false;   ///< контрольная сумма не совпала, примитивы не передаются
+        size_t batchSize = FirstBatchSize;
+    };
+
+    static constexpr size_t FirstBatchSize = 1024;  ///< размер первого пакета
+    static constexpr size_t BatchSize = 64 * 1024; ///< размер последующих пакетов
+    static constexpr size_t MaxQueuedBatches = 8;  ///< предел очереди, ограничивает память при медленном потребителе
+
+    std::shared_ptr<Shared> m_shared;
+
+public:
+    ProjectLoader() {
+
+    }
+
+    ProjectLoader(const ProjectLoader&) = delete;
+    ProjectLoader& operator=(const ProjectLoader&) = delete;
+
+    ~ProjectLoader() {
+        cancel();
+    }
+
+/*!
+Открывает файл проекта и ставит задачу чтения, возвращает <i>false</i> если заголовок или таблица секций некорректны.
+Несовпадение контрольной суммы обнаруживается позже и сообщается через <i>hasError()</i>
+\param fileName имя файла проекта
+\param scheduler планировщик задач чтения, без планировщика пакеты читаются в <i>takeBatch()</i>
+\return <i>bool</i>
+*/
+    bool start(const std::string& fileName, Scheduler::JobScheduler* scheduler = nullptr) {
+        auto shared = std::make_shared<Shared>();
+        if(!shared->reader.open(fileName, false)) {
+            return false;
+        }
+
+        shared->scheduler = scheduler;
+        m_shared = shared;
+        scheduleRead(m_shared);
+        return true;
+    }
+
+    uint32_t width() const {
+        return m_shared ? m_shared->reader.width() : 0;
+    }
+
+    uint32_t height() const {
+        return m_shared ? m_shared->reader.height() : 0;
+    }
+
+/*!
+Возвращает поколение журнала изменений, которое применяется после загрузки файла
+\return <i>uint32_t</i>
+*/
+    uint32_t journalGeneration() const {
+        return m_shared ? m_shared->reader.journalGeneration() : 0;
+    }
+
+/*!
+Возвращает количество графических примитивов в файле
+\return <i>size_t</i>
+*/
+    size_t total() const {
+        return m_shared ? m_shared->reader.count() : 0;
+    }
+
+/*!
+Возвращает количество графических примитивов, переданных потребителю
+\return <i>size_t</i>
+*/
+    size_t loaded() const {
+        return m_shared ? m_shared->loaded.load() : 0;
+    }
+
+/*!
+Возвращает долю загруженных графических примитивов от 0 до 1
+\return <i>double</i>
+*/
+    double progress() const {
+        return total() == 0 ? 1.0 : double(loaded()) / double(total());
+    }
+
+/*!
+Возвращает <i>true</i>, если все пакеты прочитаны и переданы потребителю или загрузка отменена
+\return <i>bool</i>
+*/
+    bool isFinished() const {
+        if(!m_shared) {
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        return m_shared->cancelled || (m_shared->finished && m_shared->batches.empty());
+    }
+
+/*!
+Возвращает <i>true</i>, если файл оказался поврежден. Загрузка при этом завершается без единого пакета
+\return <i>bool</i>
+*/
+    bool hasError() const {
+        if(!m_shared) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        return m_shared->failed;
+    }
+
+/*!
+Отменяет загрузку, уже переданные пакеты остаются в модели
+\return <i>void</i>
+*/
+    void cancel() {
+        if(!m_shared) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->cancelled = true;
+        m_shared->batches.clear();
+    }
+
+/*!
+Забирает следующий прочитанный пакет. С планировщиком не блокируется и возвращает <i>false</i>, если готовых пакетов нет
+\param figures контейнер, в который помещается пакет
+\return <i>bool</i>
+*/
+    bool takeBatch(std::vector<GraphicPrimitive::FigureValue>& figures) {
+        if(!m_shared) {
+            return false;
+        }
+
+        if(!m_shared->scheduler) {
+            readBatch(*m_shared);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_shared->mutex);
+            if(m_shared->batches.empty()) {
+                return false;
+            }
+
+            figures = std::move(m_shared->batches.front());
+            m_shared->batches.pop_front();
+        }
+        m_shared->loaded += figures.size();
+        scheduleRead(m_shared);
+        return true;
+    }
+
+private:
+/*!
+Ставит задачу чтения следующего пакета, если она еще не поставлена, файл не дочитан и в очереди есть место
+\param shared разделяемое состояние
+\return <i>void</i>
+*/
+    static void scheduleRead(const std::shared_ptr<Shared>& shared) {
+        if(!shared->scheduler) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if(shared->reading || shared->finished || shared->cancelled || shared->batches.size() >= MaxQueuedBatches) {
+                return;
+            }
+            shared->reading = true;
+        }
+
+        shared->scheduler->submit([shared]() {
+            readBatch(*shared);
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->reading = false;
+            }
+            scheduleRead(shared);
+        }, Scheduler::Priority::Normal);
+    }
+
+/*!
+Читает из файла один пакет и помещает его в очередь
+\param shared разделяемое состояние
+\return <i>void</i>
+*/
+    static void readBatch(Shared& shared) {
+        if(shared.cancelled || shared.finished) {
+            return;
+        }
+
+        if(!shared.verified) {
+            shared.verified = true;
+            if(!shared.reader.verify()) {
+                std::lock_guard<std::mutex> lock(shared.mutex);
+                shared.failed = true;
+                shared.finished = true;
+                return;
+            }
+        }
+
+        std::vector<GraphicPrimitive::FigureValue> batch;
+        batch.reserve(shared.batchSize);
+        size_t count = shared.reader.read(batch, shared.batchSize);
+        shared.batchSize = BatchSize;
+
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        if(count == 0) {
+            shared.finished = true;
+        }
+        else if(!shared.cancelled) {
+            shared.batches.push_back(std::move(batch));
+        }
+    }
+};
+
+}
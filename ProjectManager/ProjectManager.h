@@ -1,10 +1,17 @@
 #pragma once
 
 #include <string>
+#include <map>
+#include <mutex>
 
 #include "GraphicPrimitivesModel/GraphicPrimitivesModel.h"
 #include "GUI/View.h"
 #include "Controler/Controler.h"
+#include "Scheduler/JobScheduler.h"
+#include "ProjectArena.h"
+#include "ProjectFile.h"
+#include "ProjectLoader.h"
+#include "ProjectJournal.h"
 
 /*!
 \brief Компоненты управления проектом
@@ -19,90 +26,513 @@ namespace Project {
 /*!
 \brief Класс проекта
 
-Класс, который содержит модель графических примитивов, графическое представление примитивов и управление примитивами
+Класс, который содержит модель графических примитивов, графическое представление примитивов и управление примитивами.
+Память модели, представления и контролера выделяется из арены проекта, арена объявлена первой и разрушается последней.
+Журнал изменений объявлен после модели и отключается от нее до ее разрушения
 */
 class Project {
+    std::shared_ptr<ProjectArena> m_arena;
     std::shared_ptr<Model::GraphicPrimitivesModel> m_model;
+    std::shared_ptr<ProjectJournal> m_journal;
     std::shared_ptr<GUI::View> m_view;
     std::shared_ptr<Controler::Controler> m_controler;
     std::string m_projectFileName;
+    uint32_t m_width = 800;
+    uint32_t m_height = 600;
+    std::shared_ptr<ProjectLoader> m_loader;
+    Scheduler::JobScheduler* m_scheduler;
+    bool m_openError = false; ///< существующий файл проекта не удалось прочитать, проект остался без имени
+
 public:
-    Project(const std::string& projectFileName = {}) :
-        m_projectFileName(projectFileName)
+/*!
+Создает проект. При потоковой загрузке модель и представление создаются сразу по заголовку файла,
+а графические примитивы поступают пакетами через <i>pollLoading()</i>. Пока файл не загружен целиком, проект в него не сохраняется
+\param projectFileName имя файла проекта, пустое для нового проекта
+\param streaming загружать файл проекта потоково
+\param scheduler общий планировщик задач, на котором выполняются загрузка, сжатие журнала и обслуживание индекса
+*/
+    Project(const std::string& projectFileName = {}, bool streaming = false, Scheduler::JobScheduler* scheduler = nullptr) :
+        m_arena(std::make_shared<ProjectArena>()),
+        m_journal(std::make_shared<ProjectJournal>()),
+        m_projectFileName(projectFileName),
+        m_scheduler(scheduler)
     {
-        if(m_projectFileName.empty()) {
-            m_model = std::make_shared<Model::GraphicPrimitivesModel>();
-            m_view = std::make_shared<GUI::View>(800, 600);
-            m_controler= std::make_shared<Controler::Controler>();
+        m_journal->setScheduler(m_scheduler);
+        if(streaming && !m_projectFileName.empty()) {
+            startLoading();
+        }
+
+        if(m_projectFileName.empty() || m_loader) {
+            m_model = std::make_shared<Model::GraphicPrimitivesModel>(m_arena.get());
+            m_view = std::make_shared<GUI::View>(m_width, m_height, m_arena.get());
+            m_controler= std::make_shared<Controler::Controler>(m_arena.get());
         }
         else {
             parseProjetcFile();
         }
 
+        m_journal->attach(*m_model);
+        m_journal->setRecording(!m_loader);
+        m_view->setScheduler(m_scheduler);
         m_view->setModel(m_model);
         m_controler->setModel(m_model);
     }
+
+    Project(const Project&) = default;
+    Project(Project&&) = default;
+
+ /*!
+Копирующее присваивание через обмен: прежние модель, представление и контролер разрушаются раньше своей арены
+\param other проект
+\return <i>Project&</i>
+*/
+    Project& operator=(const Project& other) {
+        Project copy(other);
+        swap(copy);
+        return *this;
+    }
+
+ /*!
+Перемещающее присваивание через обмен. Поэлементное перемещение освободило бы прежнюю арену первой, пока прежняя модель
+еще занимает ее память, поэтому прежнее содержимое уходит во временный проект и разрушается в обратном порядке объявления
+\param other проект, после присваивания пустой
+\return <i>Project&</i>
+*/
+    Project& operator=(Project&& other) {
+        Project moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+ /*!
+Обменивает содержимое проектов
+\param other проект
+\return <i>void</i>
+*/
+    void swap(Project& other) {
+        std::swap(m_arena, other.m_arena);
+        std::swap(m_model, other.m_model);
+        std::swap(m_journal, other.m_journal);
+        std::swap(m_view, other.m_view);
+        std::swap(m_controler, other.m_controler);
+        std::swap(m_projectFileName, other.m_projectFileName);
+        std::swap(m_width, other.m_width);
+        std::swap(m_height, other.m_height);
+        std::swap(m_loader, other.m_loader);
+        std::swap(m_scheduler, other.m_scheduler);
+        std::swap(m_openError, other.m_openError);
+    }
+
+/*!
+Возвращает имя файла проекта, пустую строку для несохраненного проекта
+\return <i>const std::string&</i>
+*/
+    const std::string& fileName() const {
+        return m_projectFileName;
+    }
+
+/*!
+Возвращает <i>true</i>, если существующий файл проекта не удалось прочитать: он поврежден, оборван или записан
+другой версией формата. Такой проект создается пустым и без имени, поэтому сохраняется только в новый файл
+и не перезаписывает непрочитанный файл
+\return <i>bool</i>
+*/
+    bool hasOpenError() const {
+        return m_openError;
+    }
+
+/*!
+Сохраняет проект в файл, возвращает <i>true</i> при успехе. Пустое имя означает текущий файл проекта.
+В файл, из которого проект загружен, дописываются только изменения через журнал, без изменений сохранение пропускается.
+Другой существующий файл не перезаписывается, имя проекта меняется только после успешного сохранения
+\param fileName имя файла проекта
+\return <i>bool</i>
+*/
+    bool save(const std::string& fileName = {}) {
+        std::string target = fileName.empty() ? m_projectFileName : fileName;
+        if(target.empty() || !m_journal->save(target, m_width, m_height)) {
+            return false;
+        }
+
+        m_projectFileName = target;
+        return true;
+    }
+
+/*!
+Переносит в модель готовые пакеты потоковой загрузки, представление отрисовывает их сразу. Возвращает <i>true</i>, пока загрузка не завершена.
+Если файл оказался поврежден, проект остается пустым и без имени, как при ошибке открытия
+\param maxBatches наибольшее количество пакетов за один вызов
+\return <i>bool</i>
+*/
+    bool pollLoading(size_t maxBatches = 1) {
+        if(!m_loader) {
+            return false;
+        }
+
+        std::vector<GraphicPrimitive::FigureValue> figures;
+        for(size_t i = 0; i < maxBatches && m_loader->takeBatch(figures); i++) {
+            m_model->addFigures(figures);
+        }
+
+        if(m_loader->isFinished()) {
+            if(m_loader->hasError()) {
+                m_openError = true;
+                m_projectFileName.clear();
+            }
+            else {
+                m_journal->replay(*m_model);
+            }
+            m_journal->setRecording(true);
+            m_loader.reset();
+            return false;
+        }
+        return true;
+    }
+
+/*!
+Возвращает долю загруженных графических примитивов от 0 до 1, 1 если загрузка не идет
+\return <i>double</i>
+*/
+    double loadingProgress() const {
+        return m_loader ? m_loader->progress() : 1.0;
+    }
+
+/*!
+Отменяет потоковую загрузку, уже загруженные примитивы остаются в модели. Модель содержит только часть файла проекта,
+поэтому в этот файл проект больше не сохраняется, сохранить его можно только в новый файл
+\return <i>void</i>
+*/
+    void cancelLoading() {
+        if(m_loader) {
+            m_loader->cancel();
+            m_loader.reset();
+            m_journal->setRecording(true);
+        }
+    }
+
+/*!
+Возвращает статистику памяти проекта
+\return <i>ArenaStatistics</i>
+*/
+    ArenaStatistics memoryStatistics() const {
+        return m_arena->statistics();
+    }
+
 private:
 /*!
-Парсит файл проекта
+Запускает потоковую загрузку, размеры холста и поколение журнала берутся из заголовка файла
+\return <i>void</i>
+*/
+    void startLoading() {
+        auto loader = std::make_shared<ProjectLoader>();
+        if(!loader->start(m_projectFileName, m_scheduler)) {
+            return;
+        }
+
+        m_width = loader->width();
+        m_height = loader->height();
+        m_journal->open(m_projectFileName, loader->journalGeneration());
+        m_loader = loader;
+    }
+
+/*!
+Загружает файл проекта. Файл отображается в память, записи секций переносятся в модель одним пакетом,
+затем применяются журналы изменений. Если файла нет, создается пустой проект с этим именем. Если существующий файл
+не удалось прочитать, создается пустой проект без имени и запоминается ошибка открытия
 \return <i>void</i>
 */
     void parseProjetcFile() {
-        uint32_t width;
-        uint32_t height;
-        std::list<std::shared_ptr<GraphicPrimitive::Figure>> figures;
+        ProjectFile::Reader reader;
+        std::vector<GraphicPrimitive::FigureValue> figures;
 
-        /*...........................*/
+        bool opened = reader.open(m_projectFileName);
+        if(opened) {
+            m_width = reader.width();
+            m_height = reader.height();
+            figures.reserve(reader.count());
+            reader.read(figures);
+        }
+        else {
+            std::error_code error;
+            m_openError = std::filesystem::exists(m_projectFileName, error) || error;
+            if(m_openError) {
+                m_projectFileName.clear();
+            }
+        }
 
-        m_model = std::make_shared<Model::GraphicPrimitivesModel>(std::move(figures));
-        m_view = std::make_shared<GUI::View>(width, height);
-        m_controler= std::make_shared<Controler::Controler>();
+        m_model = std::make_shared<Model::GraphicPrimitivesModel>(m_arena.get());
+        m_model->addFigures(figures);
+        if(opened) {
+            m_journal->open(m_projectFileName, reader.journalGeneration());
+            m_journal->replay(*m_model);
+        }
+        m_view = std::make_shared<GUI::View>(m_width, m_height, m_arena.get());
+        m_controler= std::make_shared<Controler::Controler>(m_arena.get());
     }
 };
 
 /*!
 \brief Классы проекта
 
-Класс, который содержит модель графических примитивов, графическое представление примитивов и управление примитивами
+Класс, который содержит модель графических примитивов, графическое представление примитивов и управление примитивами.
+Менеджер владеет общим планировщиком задач: загрузка, сохранение, сжатие журналов и обслуживание индексов всех проектов
+выполняются на одних рабочих потоках с учетом приоритета. Идентификаторы проектов выдаются по возрастанию и не переиспользуются
+после закрытия. Мьютекс защищает только таблицу проектов: рабочие потоки лишь добавляют в нее открытые проекты, поэтому
+поток, вызывающий методы менеджера, работает с проектами вне блокировки
 */
 class ProjectManager {
     std::map<size_t, Project> m_projects;
+    mutable std::mutex m_projectsMutex;
+    size_t m_nextProjectId = 0;
+    Scheduler::JobScheduler m_scheduler; ///< объявлен последним, разрушается первым и дожидается задач, обращающихся к таблице проектов
 
 public:
 /*!
-Создает пустой проект
-\return <i>void</i>
+Создает менеджер проектов
+\param threadCount количество рабочих потоков, 0 означает количество ядер процессора
 */
-    void createProject() {
-        m_projects[m_projects.size()] = {};
+    explicit ProjectManager(size_t threadCount = 0) :
+        m_scheduler(threadCount)
+    {
+
     }
 
 /*!
-Загружает проект из файла
+Возвращает общий планировщик задач проектов
+\return <i>Scheduler::JobScheduler&</i>
+*/
+    Scheduler::JobScheduler& scheduler() {
+        return m_scheduler;
+    }
+
+/*!
+Возвращает статистику очереди планировщика: глубину и задержку до начала выполнения задач
+\param priority приоритет очереди
+\return <i>Scheduler::QueueStatistics</i>
+*/
+    Scheduler::QueueStatistics schedulerStatistics(Scheduler::Priority priority) const {
+        return m_scheduler.statistics(priority);
+    }
+
+/*!
+Создает пустой проект, возвращает идентификатор проекта
+\return <i>size_t</i>
+*/
+    size_t createProject() {
+        return insertProject(Project({}, false, &m_scheduler));
+    }
+
+/*!
+Загружает проект из файла в вызывающем потоке, возвращает идентификатор проекта. Чтобы не ждать загрузки,
+используется <i>openProjectAsync</i>
+\param projectFileName имя файла проекта
+\return <i>size_t</i>
+*/
+    size_t openProject(const std::string& projectFileName) {
+        return insertProject(Project(projectFileName, false, &m_scheduler));
+    }
+
+/*!
+Загружает проект из файла на рабочем потоке. Идентификатор выдается сразу, проект появляется в менеджере,
+когда <i>std::future</i> готов
+\param projectFileName имя файла проекта
+\return <i>std::future<size_t></i> идентификатор проекта
+*/
+    std::future<size_t> openProjectAsync(const std::string& projectFileName) {
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(m_projectsMutex);
+            index = m_nextProjectId++;
+        }
+
+        return m_scheduler.submit([this, index, projectFileName]() {
+            Project project(projectFileName, false, &m_scheduler);
+            std::lock_guard<std::mutex> lock(m_projectsMutex);
+            m_projects.emplace(index, std::move(project));
+            return index;
+        }, Scheduler::Priority::Normal);
+    }
+
+/*!
+Загружает несколько проектов параллельно, например при восстановлении рабочего пространства
+\param projectFileNames имена файлов проектов
+\return <i>std::vector<std::future<size_t>></i> идентификаторы проектов в порядке имен файлов
+*/
+    std::vector<std::future<size_t>> openProjectsAsync(const std::vector<std::string>& projectFileNames) {
+        std::vector<std::future<size_t>> indices;
+        indices.reserve(projectFileNames.size());
+        for(const auto& projectFileName : projectFileNames) {
+            indices.push_back(openProjectAsync(projectFileName));
+        }
+        return indices;
+    }
+
+/*!
+Открывает проект с потоковой загрузкой, возвращает идентификатор проекта. Примитивы появляются по мере вызовов <i>processLoading()</i>
 \param projectFileName имя файла проекта
+\return <i>size_t</i>
+*/
+    size_t openProjectStreaming(const std::string& projectFileName) {
+        return insertProject(Project(projectFileName, true, &m_scheduler));
+    }
+
+/*!
+Переносит в модели готовые пакеты всех загружающихся проектов. Вызывается из цикла обработки событий
+\return <i>bool</i> <i>true</i>, если хотя бы один проект еще загружается
+*/
+    bool processLoading() {
+        std::vector<Project*> projects;
+        {
+            std::lock_guard<std::mutex> lock(m_projectsMutex);
+            for(auto& project : m_projects) {
+                projects.push_back(&project.second);
+            }
+        }
+
+        bool loading = false;
+        for(auto project : projects) {
+            loading = project->pollLoading() || loading;
+        }
+        return loading;
+    }
+
+/*!
+Возвращает долю загруженных графических примитивов проекта от 0 до 1
+\param index идентификатор проекта
+\return <i>double</i>
+*/
+    double loadingProgress(size_t index) const {
+        auto project = findProject(index);
+        return project ? project->loadingProgress() : 1.0;
+    }
+
+/*!
+Возвращает <i>true</i>, если файл проекта не удалось прочитать и проект открыт пустым и без имени
+\param index идентификатор проекта
+\return <i>bool</i>
+*/
+    bool hasOpenError(size_t index) const {
+        auto project = findProject(index);
+        return project ? project->hasOpenError() : false;
+    }
+
+/*!
+Отменяет потоковую загрузку проекта
+\param index идентификатор проекта
 \return <i>void</i>
 */
-    void openProject(const std::string& projectFileName) {
-        m_projects[m_projects.size()] = { projectFileName };
+    void cancelLoading(size_t index) {
+        if(auto project = findProject(index)) {
+            project->cancelLoading();
+        }
     }
 
 /*!
-Закрывает проект
+Закрывает проект и ждет завершения фоновой задачи закрытия. Память проекта возвращается вместе с его ареной
 \param index идентификатор проекта
 \return <i>void</i>
 */
     void closeProject(size_t index) {
-        saveProject(index);
-        m_projects.erase(index);
+        auto closed = closeProjectAsync(index);
+        closed.wait();
+    }
+
+/*!
+Закрывает проект: проект сразу убирается из менеджера, сохранение и разрушение проекта выполняются фоновой задачей.
+Разрушение обходит элементы контейнеров проекта, а пулы арены возвращаются в кучу крупными порциями
+\param index идентификатор проекта
+\return <i>std::future<bool></i> <i>true</i>, если проект сохранен
+*/
+    std::future<bool> closeProjectAsync(size_t index) {
+        std::shared_ptr<Project> project;
+        {
+            std::lock_guard<std::mutex> lock(m_projectsMutex);
+            auto projectItr = m_projects.find(index);
+            if(projectItr == m_projects.end()) {
+                std::promise<bool> closed;
+                closed.set_value(false);
+                return closed.get_future();
+            }
+
+            project = std::make_shared<Project>(std::move(projectItr->second));
+            m_projects.erase(projectItr);
+        }
+
+        return m_scheduler.submit([project]() {
+            return project->save();
+        }, Scheduler::Priority::Background);
+    }
+
+/*!
+Возвращает количество открытых проектов
+\return <i>size_t</i>
+*/
+    size_t count() const {
+        std::lock_guard<std::mutex> lock(m_projectsMutex);
+        return m_projects.size();
+    }
+
+/*!
+Возвращает статистику памяти проекта: текущий объем, максимум и фрагментацию арены
+\param index идентификатор проекта
+\return <i>ArenaStatistics</i>
+*/
+    ArenaStatistics projectMemory(size_t index) const {
+        auto project = findProject(index);
+        return project ? project->memoryStatistics() : ArenaStatistics();
     }
 
 /*!
-Сохраняет проект
+Сохраняет проект в его файл, проекты без файла не сохраняются
 \param index идентификатор проекта
 \return <i>void</i>
 */
     void saveProject(size_t index) {
+        if(auto project = findProject(index)) {
+            project->save();
+        }
+    }
+
+/*!
+Сохраняет проект в указанный файл, возвращает <i>true</i> при успехе. Существующий файл, который проект не загружал, не перезаписывается
+\param index идентификатор проекта
+\param projectFileName имя файла проекта
+\return <i>bool</i>
+*/
+    bool saveProjectAs(size_t index, const std::string& projectFileName) {
+        auto project = findProject(index);
+        return project ? project->save(projectFileName) : false;
+    }
+
+private:
+/*!
+Добавляет проект в таблицу, возвращает идентификатор проекта
+\param project проект
+\return <i>size_t</i>
+*/
+    size_t insertProject(Project project) {
+        std::lock_guard<std::mutex> lock(m_projectsMutex);
+        auto index = m_nextProjectId++;
+        m_projects.emplace(index, std::move(project));
+        return index;
+    }
+
+/*!
+Возвращает проект по идентификатору, <i>nullptr</i> если проекта нет. Узлы <i>std::map</i> не перемещаются при добавлении,
+поэтому указатель остается действительным до закрытия проекта
+\param index идентификатор проекта
+\return <i>Project*</i>
+*/
+    Project* findProject(size_t index) {
+        std::lock_guard<std::mutex> lock(m_projectsMutex);
+        auto projectItr = m_projects.find(index);
+        return projectItr == m_projects.end() ? nullptr : &projectItr->second;
+    }
 
+    const Project* findProject(size_t index) const {
+        std::lock_guard<std::mutex> lock(m_projectsMutex);
+        auto projectItr = m_projects.find(index);
+        return projectItr == m_projects.end() ? nullptr : &projectItr->second;
     }
 };
 }
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <array>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+/*!
+\brief Компоненты выполнения задач
+\author Алексей Волков
+\version 1.0
+\date Март 2024
+
+Содержит общий планировщик задач, на котором проекты выполняют отрисовку, загрузку, сохранение и обслуживание индексов
+*/
+namespace Scheduler {
+
+/// Приоритет задачи, задачи более высокого приоритета забираются потоками раньше
+enum class Priority : size_t {
+    Interactive = 0, ///< перерисовка по действию пользователя
+    Normal = 1,      ///< загрузка проектов и обслуживание индексов
+    Background = 2   ///< сохранение и сжатие журналов
+};
+
+constexpr size_t PriorityCount = 3; ///< количество приоритетов
+
+/*!
+\brief Статистика очереди одного приоритета
+*/
+struct QueueStatistics {
+    size_t depth = 0;          ///< задач в очереди в данный момент
+    size_t submitted = 0;      ///< задач поставлено за время жизни планировщика
+    size_t completed = 0;      ///< задач выполнено
+    double averageLatency = 0; ///< среднее время от постановки задачи до начала выполнения, мс
+    double maxLatency = 0;     ///< наибольшее время от постановки задачи до начала выполнения, мс
+};
+
+/*!
+\brief Планировщик задач с перехватом работы
+
+У каждого рабочего потока свои очереди по приоритетам. Задача, поставленная из рабочего потока, попадает в его очередь,
+задачи извне распределяются по потокам по кругу. Поток берет самую свежую задачу из своей очереди, а когда она пуста,
+забирает самую старую задачу из очереди другого потока того же приоритета. Приоритеты просматриваются по порядку,
+поэтому интерактивная перерисовка выполняется раньше фонового сохранения.
+
+Рабочий поток, ожидающий результат через <i>wait()</i>, тем временем выполняет другие задачи, поэтому задачи могут ждать
+друг друга без взаимной блокировки. При разрушении планировщик дожидается выполнения всех поставленных задач
+*/
+class JobScheduler {
+    using Clock = std::chrono::steady_clock;
+
+    /// Задача в очереди
+    struct Job {
+        std::function<void()> task;
+        Clock::time_point submitted;
+    };
+
+    /// Очереди рабочего потока
+    struct Worker {
+        std::mutex mutex;
+        std::array<std::deque<Job>, PriorityCount> queues;
+    };
+
+    /// Счетчики очереди одного приоритета
+    struct QueueCounters {
+        std::atomic<size_t> depth = 0;
+        std::atomic<size_t> submitted = 0;
+        std::atomic<size_t> completed = 0;
+        std::atomic<uint64_t> latencyTotal = 0; ///< нс
+        std::atomic<uint64_t> latencyMax = 0;   ///< нс
+    };
+
+    /// Состояние параллельного цикла
+    struct ParallelState {
+        std::atomic<size_t> next = 0;
+        std::atomic<size_t> done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::array<QueueCounters, PriorityCount> m_counters;
+    std::atomic<size_t> m_pending = 0;
+    std::atomic<size_t> m_nextWorker = 0;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_jobAdded;
+    bool m_stopped = false;
+    std::vector<std::thread> m_threads;
+
+public:
+/*!
+Создает планировщик и запускает рабочие потоки
+\param threadCount количество потоков, 0 означает количество ядер процессора
+*/
+    explicit JobScheduler(size_t threadCount = 0) {
+        if(threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for(size_t i = 0; i < threadCount; i++) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+
+        m_threads.reserve(threadCount);
+        for(size_t i = 0; i < threadCount; i++) {
+            m_threads.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    ~JobScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopped = true;
+        }
+        m_jobAdded.notify_all();
+
+        for(auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+/*!
+Возвращает количество рабочих потоков
+\return <i>size_t</i>
+*/
+    size_t threadCount() const {
+        return m_threads.size();
+    }
+
+/*!
+Возвращает <i>true</i>, если вызывающий поток является рабочим потоком этого планировщика
+\return <i>bool</i>
+*/
+    bool isWorkerThread() const {
+        return currentWorker().first == this;
+    }
+
+/*!
+Ставит задачу в очередь, возвращает <i>std::future</i> с результатом задачи. Исключение задачи передается в <i>std::future</i>
+\param task вызываемый объект без параметров
+\param priority приоритет задачи
+\return <i>std::future</i>
+*/
+    template<typename Task>
+    auto submit(Task task, Priority priority = Priority::Normal) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        auto result = packaged->get_future();
+        push([packaged]() { (*packaged)(); }, priority);
+        return result;
+    }
+
+/*!
+Дожидается результата задачи. В рабочем потоке во время ожидания выполняются другие задачи
+\param future результат задачи
+\return <i>Result</i>
+*/
+    template<typename Result>
+    Result wait(std::future<Result>& future) {
+        if(isWorkerThread()) {
+            helpUntil([&future]() { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        }
+        return future.get();
+    }
+
+/*!
+Выполняет функцию для диапазона [0, count) частями по <i>grain</i> элементов. Вызывающий поток обрабатывает части
+вместе с рабочими потоками и возвращается, когда обработаны все части. Функция не должна выбрасывать исключения
+\param count количество элементов
+\param grain количество элементов в одной части
+\param function вызываемый объект с параметрами (начало, конец) части
+\param priority приоритет вспомогательных задач
+\return <i>void</i>
+*/
+    template<typename Function>
+    void parallelFor(size_t count, size_t grain, const Function& function, Priority priority = Priority::Interactive) {
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        if(chunks == 0) {
+            return;
+        }
+
+        auto state = std::make_shared<ParallelState>();
+        auto process = [state, count, grain, chunks, function = &function]() {
+            for(size_t chunk = state->next++; chunk < chunks; chunk = state->next++) {
+                (*function)(chunk * grain, std::min(count, (chunk + 1) * grain));
+                if(++state->done == chunks) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = std::min(threadCount(), chunks - 1);
+        for(size_t i = 0; i < helpers; i++) {
+            push(process, priority);
+        }
+        process();
+
+        if(isWorkerThread()) {
+            helpUntil([&state, chunks]() { return state->done == chunks; });
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state, chunks]() { return state->done == chunks; });
+    }
+
+/*!
+Возвращает статистику очереди приоритета: глубину, количество задач и задержку до начала выполнения
+\param priority приоритет
+\return <i>QueueStatistics</i>
+*/
+    QueueStatistics statistics(Priority priority) const {
+        const auto& counters = m_counters[size_t(priority)];
+        QueueStatistics statistics;
+        statistics.depth = counters.depth;
+        statistics.submitted = counters.submitted;
+        statistics.completed = counters.completed;
+        statistics.maxLatency = double(counters.latencyMax) / 1e6;
+        if(statistics.completed > 0) {
+            statistics.averageLatency = double(counters.latencyTotal) / 1e6 / double(statistics.completed);
+        }
+        return statistics;
+    }
+
+private:
+/*!
+Возвращает планировщик и номер рабочего потока, которому принадлежит вызывающий поток
+\return <i>std::pair<const JobScheduler*, size_t>&</i>
+*/
+    static std::pair<const JobScheduler*, size_t>& currentWorker() {
+        thread_local std::pair<const JobScheduler*, size_t> worker = {nullptr, 0};
+        return worker;
+    }
+
+/*!
+Помещает задачу в очередь текущего рабочего потока или, для внешнего потока, в очередь следующего по кругу и будит спящий поток
+\param task задача
+\param priority приоритет задачи
+\return <i>void</i>
+*/
+    void push(std::function<void()> task, Priority priority) {
+        size_t index = isWorkerThread() ? currentWorker().second : m_nextWorker++ % m_workers.size();
+        auto& counters = m_counters[size_t(priority)];
+        {
+            std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+            m_workers[index]->queues[size_t(priority)].push_back({std::move(task), Clock::now()});
+        }
+        counters.submitted++;
+        counters.depth++;
+        m_pending++;
+
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_jobAdded.notify_one();
+    }
+
+/*!
+Забирает задачу наивысшего приоритета: сначала из своей очереди, затем из очередей других потоков
+\param self номер рабочего потока
+\param job забранная задача
+\param priority приоритет забранной задачи
+\return <i>bool</i>
+*/
+    bool takeJob(size_t self, Job& job, size_t& priority) {
+        for(priority = 0; priority < PriorityCount; priority++) {
+            for(size_t i = 0; i < m_workers.size(); i++) {
+                auto& worker = *m_workers[(self + i) % m_workers.size()];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                auto& queue = worker.queues[priority];
+                if(queue.empty()) {
+                    continue;
+                }
+
+                if(i == 0) {
+                    job = std::move(queue.back());
+                    queue.pop_back();
+                }
+                else {
+                    job = std::move(queue.front());
+                    queue.pop_front();
+                }
+                m_counters[priority].depth--;
+                m_pending--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+/*!
+Выполняет задачу и обновляет счетчики ее очереди
+\param job задача
+\param priority приоритет задачи
+\return <i>void</i>
+*/
+    void runJob(Job& job, size_t priority) {
+        auto& counters = m_counters[priority];
+        auto latency = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - job.submitted).count());
+        counters.latencyTotal += latency;
+        auto max = counters.latencyMax.load();
+        while(latency > max && !counters.latencyMax.compare_exchange_weak(max, latency)) {
+            std::this_thread::yield();
+        }
+
+        job.task();
+        counters.completed++;
+    }
+
+/*!
+Выполняет задачи из очередей, пока условие не выполнено. Вызывается только из рабочего потока
+\param ready условие завершения ожидания
+\return <i>void</i>
+*/
+    template<typename Condition>
+    void helpUntil(Condition ready) {
+        while(!ready()) {
+            Job job;
+            size_t priority;
+            if(takeJob(currentWorker().second, job, priority)) {
+                runJob(job, priority);
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+/*!
+Тело рабочего потока: выполняет задачи, пока планировщик не остановлен и очереди не пусты
+\param self номер рабочего потока
+\return <i>void</i>
+*/
+    void work(size_t self) {
+        currentWorker() = {this, self};
+        while(true) {
+            Job job;
+            size_t priority;
+            if(takeJob(self, job, priority)) {
+                runJob(job, priority);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_jobAdded.wait(lock, [this]() { return m_stopped || m_pending > 0; });
+            if(m_stopped && m_pending == 0) {
+                return;
+            }
+        }
+    }
+};
+
+}
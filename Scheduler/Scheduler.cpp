@@ -0,0 +1,2 @@
+#include "JobScheduler.h"
+#include "SpscQueue.h"
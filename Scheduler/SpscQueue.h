@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace Scheduler {
+
+/*!
+\brief Очередь одного производителя и одного потребителя без блокировок
+
+Кольцевой буфер фиксированной емкости. Производитель и потребитель синхронизируются только атомарными индексами начала и конца,
+индексы разнесены по разным строкам кэша. Емкость округляется вверх до степени двойки
+*/
+template<typename T>
+class SpscQueue {
+    static constexpr size_t CacheLineSize = 64;
+
+    std::vector<T> m_buffer;
+    size_t m_mask;
+    alignas(CacheLineSize) std::atomic<size_t> m_head = 0; ///< следующий элемент для потребителя
+    alignas(CacheLineSize) std::atomic<size_t> m_tail = 0; ///< следующее место для производителя
+
+public:
+/*!
+Создает очередь
+\param capacity наименьшая емкость очереди
+*/
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while(size < capacity) {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const {
+        return m_buffer.size();
+    }
+
+/*!
+Возвращает приблизительное количество элементов в очереди
+\return <i>size_t</i>
+*/
+    size_t size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+/*!
+Помещает элемент в очередь, возвращает <i>false</i> если очередь заполнена. Вызывается только производителем
+\param value элемент
+\return <i>bool</i>
+*/
+    bool tryPush(T&& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) == m_buffer.size()) {
+            return false;
+        }
+
+        m_buffer[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+/*!
+Забирает элемент из очереди, возвращает <i>false</i> если очередь пуста. Вызывается только потребителем
+\param value забранный элемент
+\return <i>bool</i>
+*/
+    bool tryPop(T& value) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = std::move(m_buffer[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+}
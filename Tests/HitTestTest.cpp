@@ -0,0 +1,162 @@
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "GUI/View.h"
+
+/*!
+Сравнение выбора фигур представлением с линейным просмотром модели. Случайные фигуры всех типов: с заливкой и без,
+без кисти, с толстой кистью, отрезки нулевой длины, вырожденные окружности и эллипсы с нулевыми радиусами; часть фигур
+удаляется. Для нескольких видимых областей, от сильного уменьшения до увеличения, <i>figureAt</i> сверяется с поиском сверху вниз
+первой фигуры, для которой <i>hitTest</i> истинен, а <i>figuresInArea</i> в обоих режимах - с проверкой каждой фигуры по
+<i>figureBounds</i> и <i>intersectsArea</i>. Точки берутся как по всей сцене, так и у границ и контуров фигур.
+Аргументы: количество фигур (по умолчанию 3000), количество запросов на видимую область (по умолчанию 500),
+начальное значение генератора (по умолчанию 1)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+using GUI::Area;
+
+constexpr double World = 2000; ///< координаты фигур лежат в [-World, World]
+
+std::mt19937 generator;
+
+double uniform(double from, double to) {
+    return std::uniform_real_distribution<double>(from, to)(generator);
+}
+
+size_t below(size_t bound) {
+    return std::uniform_int_distribution<size_t>(0, bound - 1)(generator);
+}
+
+float randomPenWidth() {
+    double kind = uniform(0, 1);
+    return float(kind < 0.3 ? uniform(0, 1) : kind < 0.8 ? uniform(1, 6) : uniform(6, 60));
+}
+
+PenType randomPenType() {
+    return below(8) == 0 ? PenType::None : PenType(1 + below(3));
+}
+
+BrushType randomBrushType() {
+    return below(2) == 0 ? BrushType::None : BrushType(1 + below(3));
+}
+
+/*!
+Возвращает размер фигуры, иногда нулевой, чтобы получить вырожденные фигуры
+\return <i>double</i>
+*/
+double randomSize() {
+    double kind = uniform(0, 1);
+    return kind < 0.1 ? 0 : kind < 0.4 ? uniform(0.1, 5) : kind < 0.95 ? uniform(5, 150) : uniform(150, 800);
+}
+
+FigureValue randomFigure() {
+    Point point = {uniform(-World, World), uniform(-World, World)};
+    uint32_t color = 0xFF000000u | uint32_t(generator());
+    switch(below(5)) {
+    case 0: {
+        double length = randomSize();
+        double angle = uniform(0, 6.3);
+        return Line(point, {point.x + length * std::cos(angle), point.y + length * std::sin(angle)}, color, randomPenType(), randomPenWidth());
+    }
+    case 1:
+        return Rectangle(point, float(randomSize()), float(randomSize()), color, randomPenType(), randomPenWidth(), color, randomBrushType());
+    case 2:
+        return Square(point, float(randomSize()), color, randomPenType(), randomPenWidth(), color, randomBrushType());
+    case 3:
+        return Circle(point, float(randomSize()), color, randomPenType(), randomPenWidth(), color, randomBrushType());
+    default:
+        return Ellipse(point, float(randomSize()), float(randomSize()), color, randomPenType(), randomPenWidth(), color, randomBrushType());
+    }
+}
+
+/*!
+Возвращает точку сцены для запроса: случайную или у границы области случайной фигуры, где проходят контуры
+\param model модель
+\return <i>Point</i>
+*/
+Point randomPoint(const Model::GraphicPrimitivesModel& model) {
+    if(model.count() == 0 || below(3) == 0) {
+        return {uniform(-World - 100, World + 100), uniform(-World - 100, World + 100)};
+    }
+
+    Area bounds = GUI::figureBounds(model.figure(below(model.count())));
+    double x = below(2) == 0 ? uniform(bounds.corner.x, bounds.right()) : (below(2) == 0 ? bounds.corner.x : bounds.right()) + uniform(-3, 3);
+    double y = below(2) == 0 ? uniform(bounds.corner.y, bounds.bottom()) : (below(2) == 0 ? bounds.corner.y : bounds.bottom()) + uniform(-3, 3);
+    return {x, y};
+}
+
+Area randomArea(const Model::GraphicPrimitivesModel& model) {
+    Point corner = randomPoint(model);
+    double size = below(4) == 0 ? uniform(0, 2) : below(3) == 0 ? uniform(500, 3000) : uniform(2, 300);
+    return {corner, size * uniform(0.3, 1.5), size * uniform(0.3, 1.5)};
+}
+
+size_t linearFigureAt(const Model::GraphicPrimitivesModel& model, const Point& point, double tolerance) {
+    for(size_t index = model.count(); index > 0; index--) {
+        if(GUI::hitTest(model.figure(index - 1), point, tolerance)) {
+            return index - 1;
+        }
+    }
+    return model.count();
+}
+
+std::vector<size_t> linearFiguresInArea(const Model::GraphicPrimitivesModel& model, const Area& area, GUI::View::SelectionMode mode) {
+    std::vector<size_t> result;
+    for(size_t index = 0; index < model.count(); index++) {
+        const auto& figure = model.figure(index);
+        if(mode == GUI::View::SelectionMode::Contained ? area.contains(GUI::figureBounds(figure)) : GUI::intersectsArea(figure, area)) {
+            result.push_back(index);
+        }
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 3000;
+    size_t queries = argc > 2 ? size_t(std::strtoull(argv[2], nullptr, 10)) : 500;
+    generator.seed(argc > 3 ? unsigned(std::strtoul(argv[3], nullptr, 10)) : 1);
+
+    auto model = std::make_shared<Model::GraphicPrimitivesModel>();
+    GUI::View view(320, 240);
+    view.setModel(model);
+
+    std::vector<FigureValue> figures;
+    for(size_t i = 0; i < count; i++) {
+        figures.push_back(randomFigure());
+    }
+    model->addFigures(figures);
+    for(size_t i = 0; i < count / 10; i++) {
+        model->removeFigure(below(model->count()));
+    }
+    for(size_t i = 0; i < count / 10; i++) {
+        std::visit([&model](const auto& figure) { model->addFigure(figure); }, randomFigure());
+    }
+
+    for(double scale : {0.02, 0.25, 1.0, 3.0, 40.0}) {
+        Point origin = {uniform(-World, World / 2), uniform(-World, World / 2)};
+        view.setViewport(origin, scale);
+        for(size_t query = 0; query < queries; query++) {
+            Point point = randomPoint(*model);
+            double tolerance = below(3) == 0 ? 0 : uniform(0, 6);
+            size_t found = view.figureAt(point, tolerance);
+            size_t expected = linearFigureAt(*model, point, tolerance / scale);
+            Test::check(found == expected, "scale %g: figureAt(%g, %g, %g) = %zu, expected %zu", scale, point.x, point.y, tolerance, found, expected);
+
+            Area area = randomArea(*model);
+            for(auto mode : {GUI::View::SelectionMode::Contained, GUI::View::SelectionMode::Intersected}) {
+                auto selected = view.figuresInArea(area, mode);
+                auto expectedSelection = linearFiguresInArea(*model, area, mode);
+                Test::check(selected == expectedSelection, "scale %g: figuresInArea(%g, %g, %g, %g) %s selects %zu figures, expected %zu",
+                            scale, area.corner.x, area.corner.y, area.width, area.height,
+                            mode == GUI::View::SelectionMode::Contained ? "contained" : "intersected", selected.size(), expectedSelection.size());
+            }
+        }
+    }
+
+    return Test::result("HitTestTest");
+}
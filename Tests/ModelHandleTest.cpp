@@ -0,0 +1,97 @@
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "GraphicPrimitivesModel/GraphicPrimitivesModel.h"
+
+/*!
+Проверка идентификаторов графических примитивов модели. Случайно добавляются примитивы по одному и диапазонами,
+удаляются по индексу, по идентификатору и наборами индексов, в том числе внутри пакета. После каждой операции
+<i>indexOf</i> каждого живого идентификатора сверяется с линейным поиском в порядке отрисовки, а идентификаторы удаленных
+примитивов должны быть недействительны, даже если их слот занят заново.
+Аргументы: количество операций (по умолчанию 5000), начальное значение генератора (по умолчанию 1)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+
+Circle numbered(size_t number) {
+    return Circle({double(number), 0}, 1, 0, PenType::Solid, 1, 0, BrushType::None);
+}
+
+void checkHandles(const Model::GraphicPrimitivesModel& model, const std::vector<Model::FigureHandle>& live,
+                  const std::vector<Model::FigureHandle>& removed) {
+    Test::check(model.count() == live.size(), "count %zu, expected %zu", model.count(), live.size());
+    for(size_t index = 0; index < live.size(); index++) {
+        Test::check(model.handle(index) == live[index], "handle(%zu) differs from the expected order", index);
+        Test::check(model.indexOf(live[index]) == index, "indexOf at %zu: %zu", index, model.indexOf(live[index]));
+    }
+    for(const auto& handle : removed) {
+        Test::check(!model.contains(handle) && model.indexOf(handle) == model.count(), "removed handle (%u, %u) is still valid",
+                    handle.slot, handle.generation);
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 5000;
+    std::mt19937 generator(argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1);
+    auto below = [&generator](size_t bound) {
+        return std::uniform_int_distribution<size_t>(0, bound - 1)(generator);
+    };
+
+    Model::GraphicPrimitivesModel model;
+    std::vector<Model::FigureHandle> live;
+    std::vector<Model::FigureHandle> removed;
+    size_t next = 0;
+    for(size_t operation = 0; operation < operations; operation++) {
+        size_t kind = live.empty() ? 0 : below(6);
+        if(kind == 0) {
+            live.push_back(model.addFigure(numbered(next++)));
+        }
+        else if(kind == 1) {
+            std::vector<FigureValue> figures;
+            for(size_t i = below(20); i > 0; i--) {
+                figures.push_back(numbered(next++));
+            }
+            model.addFigures(figures);
+            for(size_t i = live.size(); i < model.count(); i++) {
+                live.push_back(model.handle(i));
+            }
+        }
+        else if(kind == 2) {
+            size_t index = below(live.size());
+            model.removeFigure(index);
+            removed.push_back(live[index]);
+            live.erase(live.begin() + std::ptrdiff_t(index));
+        }
+        else if(kind == 3) {
+            size_t index = below(live.size());
+            model.removeFigure(live[index]);
+            removed.push_back(live[index]);
+            live.erase(live.begin() + std::ptrdiff_t(index));
+        }
+        else {
+            Model::GraphicPrimitivesModel::BatchGuard batch(model);
+            if(kind == 5) {
+                live.push_back(model.addFigure(numbered(next++)));
+            }
+            std::vector<size_t> indices;
+            for(size_t i = below(8); i > 0; i--) {
+                indices.push_back(below(live.size() + 2));
+            }
+            model.removeFigures(indices);
+            std::sort(indices.begin(), indices.end());
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+            for(auto indexItr = indices.rbegin(); indexItr != indices.rend(); ++indexItr) {
+                if(*indexItr < live.size()) {
+                    removed.push_back(live[*indexItr]);
+                    live.erase(live.begin() + std::ptrdiff_t(*indexItr));
+                }
+            }
+        }
+        checkHandles(model, live, removed);
+    }
+    return Test::result("ModelHandleTest");
+}
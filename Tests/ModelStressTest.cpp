@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "GraphicPrimitivesModel/GraphicPrimitivesModel.h"
+
+/*!
+Нагрузочная проверка модели с одним писателем и несколькими читателями. Писатель циклически сдвигает модель:
+удаляет первый графический примитив и добавляет в конец новый, периодически выполняя то же пакетом. Номер примитива
+хранится в координате x центра круга, поэтому в любой опубликованной версии номера идут подряд, а примитивов столько же
+или на один меньше, чем в начале. Читатели проверяют это на каждом снимке. Callback-и проверяют, что вне пакета
+опубликована версия, которую они описывают, а внутри пакета рабочая версия содержит описанный диапазон.
+Аргументы: количество примитивов (по умолчанию 10000), количество операций писателя (по умолчанию 20000),
+количество читателей (по умолчанию 4). Возвращает ненулевой код, если найдено нарушение
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+
+Circle numbered(size_t number) {
+    return Circle({double(number), 0}, 1, 0, PenType::Solid, 1, 0, BrushType::None);
+}
+
+double number(const FigureValue& figure) {
+    const Circle* circle = std::get_if<Circle>(&figure);
+    return circle ? circle->center().x : -1;
+}
+
+size_t argument(int argc, char* argv[], int index, size_t fallback) {
+    return index < argc ? size_t(std::strtoull(argv[index], nullptr, 10)) : fallback;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argument(argc, argv, 1, 10000);
+    size_t operations = argument(argc, argv, 2, 20000);
+    size_t readerCount = argument(argc, argv, 3, 4);
+    const size_t batchPeriod = 1000;
+    const size_t batchSize = 10;
+
+    Model::GraphicPrimitivesModel model;
+    size_t next = 0;
+    for(; next < count; next++) {
+        model.addFigure(numbered(next));
+    }
+
+    std::atomic<size_t> violations = 0;
+    std::atomic<size_t> snapshots = 0;
+    std::atomic<bool> writing = true;
+    bool inBatch = false;
+
+    auto checkPublished = [&](size_t end) {
+        size_t published = inBatch ? model.currentSnapshot().count() : model.snapshot().count();
+        if(published != model.count() || end > model.count()) {
+            violations++;
+        }
+    };
+    model.connectToAddFigures([&](size_t first, size_t added) { checkPublished(first + added); });
+    model.connectToRemoveFigures([&](size_t first, size_t) { checkPublished(first); });
+
+    std::vector<std::thread> readers;
+    for(size_t i = 0; i < readerCount; i++) {
+        readers.emplace_back([&]() {
+            while(writing) {
+                auto snapshot = model.snapshot();
+                bool consistent = snapshot.count() == count || snapshot.count() + 1 == count;
+                double front = number(snapshot.figure(size_t(0)));
+                for(size_t j = 0; consistent && j < snapshot.count(); j++) {
+                    consistent = number(snapshot.figure(j)) == front + double(j);
+                }
+                if(!consistent) {
+                    violations++;
+                }
+                snapshots++;
+            }
+        });
+    }
+
+    for(size_t operation = 0; operation < operations; operation++) {
+        if(operation % batchPeriod == batchPeriod - 1) {
+            Model::GraphicPrimitivesModel::BatchGuard batch(model);
+            inBatch = true;
+            for(size_t i = 0; i < batchSize; i++) {
+                model.addFigure(numbered(next++));
+            }
+            std::vector<size_t> indices(batchSize);
+            for(size_t i = 0; i < batchSize; i++) {
+                indices[i] = i;
+            }
+            model.removeFigures(std::move(indices));
+            inBatch = false;
+        }
+        else {
+            model.removeFigure(size_t(0));
+            model.addFigure(numbered(next++));
+        }
+    }
+
+    writing = false;
+    for(auto& reader : readers) {
+        reader.join();
+    }
+
+    std::printf("operations %zu, snapshots %zu, violations %zu\n", operations, snapshots.load(), violations.load());
+    return violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
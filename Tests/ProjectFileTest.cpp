@@ -0,0 +1,176 @@
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "ProjectManager/ProjectManager.h"
+
+/*!
+Проверка файла проекта. Случайные графические примитивы всех типов, включая невалидный, записываются в файл и читаются
+обратно: примитивы, размеры холста и поколение журнала должны совпасть. Файл другой версии, оборванный файл и файл
+с неверной контрольной суммой не должны открываться. Проект из такого файла открывается пустым и без имени,
+а сохранение и закрытие проекта, в том числе после потоковой загрузки, не перезаписывают непрочитанный файл.
+Аргументы: количество примитивов (по умолчанию 5000), начальное значение генератора (по умолчанию 1)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+namespace ProjectFile = Project::ProjectFile;
+
+std::mt19937 generator;
+
+size_t below(size_t bound) {
+    return std::uniform_int_distribution<size_t>(0, bound - 1)(generator);
+}
+
+FigureValue randomFigure() {
+    double x = double(below(100000)) / 7;
+    double y = double(below(100000)) / 7;
+    float size = float(below(1000)) / 3;
+    uint32_t color = uint32_t(generator());
+    switch(below(6)) {
+    case 0:
+        return Line({x, y}, {x + size, y - size}, color, PenType(below(4)), 1 + float(below(4)));
+    case 1:
+        return Rectangle({x, y}, size, size / 2, color, PenType(below(3)), 1, ~color, BrushType(below(4)));
+    case 2:
+        return Circle({x, y}, size, color, PenType::Dash, 2, ~color, BrushType::Solid);
+    case 3:
+        return Square({x, y}, size, color, PenType::Dot, 3, ~color, BrushType::None);
+    case 4:
+        return Ellipse({x, y}, size, size / 3, color, PenType::Solid, 1, ~color, BrushType::Horizontal);
+    default:
+        return InvalidFigure();
+    }
+}
+
+bool sameFigure(const FigureValue& left, const FigureValue& right) {
+    auto leftRecord = std::visit([](const auto& value) { return ProjectFile::encode(value); }, left);
+    auto rightRecord = std::visit([](const auto& value) { return ProjectFile::encode(value); }, right);
+    return asFigure(left).type() == asFigure(right).type() && std::memcmp(&leftRecord, &rightRecord, sizeof(leftRecord)) == 0;
+}
+
+std::vector<char> contents(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write(const std::string& fileName, const std::vector<char>& bytes) {
+    std::ofstream(fileName, std::ios::binary | std::ios::trunc).write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+void testRoundTrip(const std::string& fileName, const std::vector<FigureValue>& figures) {
+    bool saved = ProjectFile::save(fileName, 1920, 1080, figures.size(),
+                                   [&figures](size_t i) -> const FigureValue& { return figures[i]; }, 7);
+    Test::check(saved, "round trip: file is not written");
+
+    ProjectFile::Reader reader;
+    if(!Test::check(reader.open(fileName), "round trip: file is not opened")) {
+        return;
+    }
+    Test::check(reader.width() == 1920 && reader.height() == 1080, "round trip: canvas %ux%u", reader.width(), reader.height());
+    Test::check(reader.journalGeneration() == 7, "round trip: journal generation %u", reader.journalGeneration());
+    Test::check(reader.count() == figures.size(), "round trip: count %zu, expected %zu", reader.count(), figures.size());
+
+    // Чтение частями должно дать тот же порядок, что и запись
+    std::vector<FigureValue> loaded;
+    while(reader.read(loaded, 1 + below(1000)) > 0) {
+
+    }
+    Test::check(loaded.size() == figures.size(), "round trip: read %zu figures, expected %zu", loaded.size(), figures.size());
+    for(size_t i = 0; i < std::min(loaded.size(), figures.size()); i++) {
+        Test::check(sameFigure(figures[i], loaded[i]), "round trip: figure %zu differs", i);
+    }
+}
+
+/*!
+Проверяет, что поврежденный файл не открывается ни читателем, ни проектом, и что проект не перезаписывает его
+\param fileName имя поврежденного файла
+\param name описание повреждения
+\return <i>void</i>
+*/
+void checkRejected(const std::string& fileName, const char* name) {
+    ProjectFile::Reader reader;
+    Test::check(!reader.open(fileName), "%s: file is opened", name);
+
+    auto bytes = contents(fileName);
+    {
+        Project::Project project(fileName);
+        Test::check(project.hasOpenError() && project.fileName().empty(), "%s: project is opened without an error", name);
+        Test::check(!project.save() && !project.save(fileName), "%s: project is saved over the unreadable file", name);
+    }
+    {
+        Project::Project project(fileName, true);
+        while(project.pollLoading(4)) {
+
+        }
+        Test::check(project.hasOpenError() && project.fileName().empty(), "%s: streaming project is opened without an error", name);
+        Test::check(!project.save() && !project.save(fileName), "%s: streaming project is saved over the unreadable file", name);
+    }
+    Test::check(contents(fileName) == bytes, "%s: unreadable file is changed", name);
+}
+
+void testRejected(const std::string& fileName, const std::filesystem::path& directory) {
+    auto bytes = contents(fileName);
+    std::string damagedName = (directory / "damaged.ht5").string();
+
+    auto damaged = bytes;
+    uint32_t version = 3;
+    std::memcpy(damaged.data() + offsetof(ProjectFile::FileHeader, version), &version, sizeof(version));
+    write(damagedName, damaged);
+    checkRejected(damagedName, "future version");
+
+    version = 1;
+    std::memcpy(damaged.data() + offsetof(ProjectFile::FileHeader, version), &version, sizeof(version));
+    write(damagedName, damaged);
+    checkRejected(damagedName, "previous version");
+
+    for(size_t size : {bytes.size() - 8, bytes.size() - 1, bytes.size() / 2, sizeof(ProjectFile::FileHeader) + 8, size_t(12)}) {
+        write(damagedName, std::vector<char>(bytes.begin(), bytes.begin() + std::ptrdiff_t(size)));
+        checkRejected(damagedName, "truncated");
+    }
+
+    for(size_t position : {bytes.size() - 1, bytes.size() / 2, sizeof(ProjectFile::FileHeader) + sizeof(ProjectFile::SectionHeader) * ProjectFile::SectionCount,
+                           offsetof(ProjectFile::FileHeader, checksum)}) {
+        damaged = bytes;
+        damaged[position] ^= 0x10;
+        write(damagedName, damaged);
+        checkRejected(damagedName, "bad checksum");
+
+        ProjectFile::Reader reader;
+        Test::check(reader.open(damagedName, false) && !reader.verify(), "bad checksum: deferred verification passes at %zu", position);
+    }
+
+    // Файла нет: это новый проект с именем, а не ошибка открытия
+    std::string newName = (directory / "new.ht5").string();
+    Project::Project project(newName);
+    Test::check(!project.hasOpenError() && project.fileName() == newName, "missing file: project is not a new named project");
+    Test::check(project.save() && ProjectFile::Reader().open(newName), "missing file: new project is not saved");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 5000;
+    generator.seed(argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1);
+
+    auto directory = std::filesystem::temp_directory_path() / ("ProjectFileTest." + std::to_string(generator()));
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    std::vector<FigureValue> figures;
+    for(size_t i = 0; i < count; i++) {
+        figures.push_back(randomFigure());
+    }
+
+    std::string fileName = (directory / "project.ht5").string();
+    testRoundTrip(fileName, figures);
+    testRoundTrip((directory / "empty.ht5").string(), {});
+    testRejected(fileName, directory);
+
+    std::filesystem::remove_all(directory);
+    return Test::result("ProjectFileTest");
+}
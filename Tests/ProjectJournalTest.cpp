@@ -0,0 +1,328 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "ProjectManager/ProjectManager.h"
+
+/*!
+Проверка журнала изменений проекта. Проект сохраняется снимком, затем случайные изменения дописываются в журнал;
+после повторной загрузки с применением журналов модель должна совпасть с исходной. Оборванная и испорченная последняя
+запись журнала отбрасываются, а новые записи после них читаются. Сжатие с малым порогом проверяется так же через
+повторную загрузку. Существующий чужой файл и файл, загруженный не целиком, не должны перезаписываться, в том числе
+проектом при незавершенной и отмененной потоковой загрузке.
+Аргументы: начальное значение генератора (по умолчанию 1)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+using Project::ProjectJournal;
+
+std::mt19937 generator;
+
+size_t below(size_t bound) {
+    return std::uniform_int_distribution<size_t>(0, bound - 1)(generator);
+}
+
+FigureValue randomFigure() {
+    float x = float(below(1000));
+    float y = float(below(1000));
+    float size = float(below(100));
+    uint32_t color = uint32_t(generator());
+    switch(below(5)) {
+    case 0:
+        return Line({x, y}, {x + size, y - size}, color, PenType(below(3)), 1 + float(below(4)));
+    case 1:
+        return Rectangle({x, y}, size, size / 2, color, PenType::Solid, 1, ~color, BrushType(below(3)));
+    case 2:
+        return Circle({x, y}, size, color, PenType::Dash, 2, ~color, BrushType::Solid);
+    case 3:
+        return Square({x, y}, size, color, PenType::Dot, 3, ~color, BrushType::None);
+    default:
+        return Ellipse({x, y}, size, size / 3, color, PenType::Solid, 1, ~color, BrushType::Horizontal);
+    }
+}
+
+/*!
+Выполняет случайные добавления и удаления графических примитивов
+\param model модель
+\param operations количество операций
+\return <i>void</i>
+*/
+void edit(Model::GraphicPrimitivesModel& model, size_t operations) {
+    for(size_t operation = 0; operation < operations; operation++) {
+        size_t kind = model.count() == 0 ? 0 : below(4);
+        if(kind == 0) {
+            std::visit([&model](const auto& figure) { model.addFigure(figure); }, randomFigure());
+        }
+        else if(kind == 1) {
+            std::vector<FigureValue> figures;
+            for(size_t i = 1 + below(10); i > 0; i--) {
+                figures.push_back(randomFigure());
+            }
+            model.addFigures(figures);
+        }
+        else if(kind == 2) {
+            model.removeFigure(below(model.count()));
+        }
+        else {
+            model.removeFigures({below(model.count()), below(model.count())});
+        }
+    }
+}
+
+std::vector<FigureValue> figuresOf(const Model::GraphicPrimitivesModel& model) {
+    std::vector<FigureValue> figures;
+    for(size_t i = 0; i < model.count(); i++) {
+        figures.push_back(model.figure(i));
+    }
+    return figures;
+}
+
+bool sameFigures(const std::vector<FigureValue>& left, const std::vector<FigureValue>& right) {
+    if(left.size() != right.size()) {
+        return false;
+    }
+
+    for(size_t i = 0; i < left.size(); i++) {
+        auto leftRecord = std::visit([](const auto& value) { return Project::ProjectFile::encode(value); }, left[i]);
+        auto rightRecord = std::visit([](const auto& value) { return Project::ProjectFile::encode(value); }, right[i]);
+        if(asFigure(left[i]).type() != asFigure(right[i]).type() || std::memcmp(&leftRecord, &rightRecord, sizeof(leftRecord)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+Загружает файл проекта в модель так же, как проект: снимок, затем журналы поверх него
+\param fileName имя файла проекта
+\param model пустая модель
+\param journal журнал, который связывается с моделью
+\return <i>bool</i>
+*/
+bool load(const std::string& fileName, Model::GraphicPrimitivesModel& model, ProjectJournal& journal) {
+    Project::ProjectFile::Reader reader;
+    if(!reader.open(fileName)) {
+        return false;
+    }
+
+    std::vector<FigureValue> figures;
+    reader.read(figures);
+    model.addFigures(figures);
+    journal.attach(model);
+    journal.open(fileName, reader.journalGeneration());
+    journal.replay(model);
+    return true;
+}
+
+std::vector<char> contents(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/*!
+Возвращает имя последнего существующего журнала проекта
+\param fileName имя файла проекта
+\return <i>std::string</i>
+*/
+std::string lastJournal(const std::string& fileName) {
+    std::string last;
+    for(uint32_t generation = 0; generation < 1000; generation++) {
+        if(std::filesystem::exists(ProjectJournal::journalName(fileName, generation))) {
+            last = ProjectJournal::journalName(fileName, generation);
+        }
+    }
+    return last;
+}
+
+void testReplay(const std::filesystem::path& directory) {
+    std::string fileName = (directory / "replay.ht5").string();
+    Model::GraphicPrimitivesModel model;
+    ProjectJournal journal;
+    journal.attach(model);
+    edit(model, 50);
+    Test::check(journal.save(fileName, 640, 480), "replay: snapshot is not written");
+
+    for(size_t round = 0; round < 10; round++) {
+        edit(model, 20);
+        Test::check(journal.save(fileName, 640, 480), "replay: journal is not written at round %zu", round);
+
+        Model::GraphicPrimitivesModel loaded;
+        ProjectJournal loadedJournal;
+        Test::check(load(fileName, loaded, loadedJournal), "replay: file is not opened at round %zu", round);
+        Test::check(sameFigures(figuresOf(model), figuresOf(loaded)), "replay: loaded model differs at round %zu", round);
+    }
+}
+
+void testTornTail(const std::filesystem::path& directory) {
+    std::string fileName = (directory / "torn.ht5").string();
+    std::vector<FigureValue> expected;
+    {
+        Model::GraphicPrimitivesModel model;
+        ProjectJournal journal;
+        journal.attach(model);
+        edit(model, 30);
+        journal.save(fileName, 640, 480);
+        edit(model, 30);
+        journal.save(fileName, 640, 480);
+        expected = figuresOf(model);
+
+        std::visit([&model](const auto& figure) { model.addFigure(figure); }, randomFigure());
+        journal.save(fileName, 640, 480);
+    }
+
+    // Порча последней записи: запись и все после нее отбрасываются
+    std::string journalName = lastJournal(fileName);
+    auto bytes = contents(journalName);
+    bytes[bytes.size() - 8] ^= 0x5A;
+    std::ofstream(journalName, std::ios::binary | std::ios::trunc).write(bytes.data(), std::streamsize(bytes.size()));
+    {
+        Model::GraphicPrimitivesModel loaded;
+        ProjectJournal journal;
+        load(fileName, loaded, journal);
+        Test::check(sameFigures(expected, figuresOf(loaded)), "torn tail: corrupted frame is applied");
+    }
+
+    // Оборванная запись: хвост обрезается при загрузке, новые записи следуют за корректными
+    std::ofstream(journalName, std::ios::binary | std::ios::app).write("HT5J torn", 9);
+    {
+        Model::GraphicPrimitivesModel loaded;
+        ProjectJournal journal;
+        load(fileName, loaded, journal);
+        Test::check(sameFigures(expected, figuresOf(loaded)), "torn tail: truncated frame is applied");
+
+        edit(loaded, 20);
+        Test::check(journal.save(fileName, 640, 480), "torn tail: journal is not written after truncation");
+        expected = figuresOf(loaded);
+    }
+    {
+        Model::GraphicPrimitivesModel loaded;
+        ProjectJournal journal;
+        load(fileName, loaded, journal);
+        Test::check(sameFigures(expected, figuresOf(loaded)), "torn tail: frames written after truncation are lost");
+    }
+}
+
+void testCompaction(const std::filesystem::path& directory) {
+    std::string fileName = (directory / "compaction.ht5").string();
+    Model::GraphicPrimitivesModel model;
+    ProjectJournal journal;
+    journal.setCompactionThreshold(16);
+    journal.attach(model);
+    edit(model, 20);
+    journal.save(fileName, 640, 480);
+
+    for(size_t round = 0; round < 20; round++) {
+        edit(model, 10);
+        Test::check(journal.save(fileName, 640, 480), "compaction: save fails at round %zu", round);
+    }
+    Test::check(journal.waitForCompaction(), "compaction: background snapshot fails");
+
+    Model::GraphicPrimitivesModel loaded;
+    ProjectJournal loadedJournal;
+    Test::check(load(fileName, loaded, loadedJournal), "compaction: file is not opened");
+    Test::check(sameFigures(figuresOf(model), figuresOf(loaded)), "compaction: loaded model differs");
+    Test::check(!std::filesystem::exists(ProjectJournal::journalName(fileName, 0)), "compaction: stale journal is not removed");
+}
+
+void testOwnership(const std::filesystem::path& directory) {
+    // Существующий файл, который журнал не загружал, не перезаписывается
+    std::string foreignName = (directory / "foreign.ht5").string();
+    std::ofstream(foreignName, std::ios::binary).write("not a project", 13);
+    {
+        Model::GraphicPrimitivesModel model;
+        ProjectJournal journal;
+        journal.attach(model);
+        edit(model, 10);
+        Test::check(!journal.save(foreignName, 640, 480), "ownership: foreign file is overwritten");
+    }
+    auto foreign = contents(foreignName);
+    Test::check(std::string(foreign.begin(), foreign.end()) == "not a project", "ownership: foreign file is changed");
+
+    // Файл, загруженный не целиком, не перезаписывается ни снимком, ни журналом
+    std::string fileName = (directory / "partial.ht5").string();
+    {
+        Model::GraphicPrimitivesModel model;
+        ProjectJournal journal;
+        journal.attach(model);
+        edit(model, 50);
+        journal.save(fileName, 640, 480);
+    }
+    auto snapshot = contents(fileName);
+    {
+        Project::ProjectFile::Reader reader;
+        reader.open(fileName);
+        std::vector<FigureValue> figures;
+        reader.read(figures, reader.count() / 2);
+
+        Model::GraphicPrimitivesModel model;
+        ProjectJournal journal;
+        journal.attach(model);
+        journal.open(fileName, reader.journalGeneration());
+        model.addFigures(figures);
+        edit(model, 5);
+        Test::check(!journal.isComplete() && !journal.save(fileName, 640, 480), "ownership: partially loaded file is saved");
+
+        std::string copyName = (directory / "partial-copy.ht5").string();
+        Test::check(journal.save(copyName, 640, 480), "ownership: partially loaded project is not saved to a new file");
+    }
+    Test::check(contents(fileName) == snapshot, "ownership: partially loaded file is changed");
+    Test::check(!std::filesystem::exists(ProjectJournal::journalName(fileName, 0)), "ownership: journal is written for a partially loaded file");
+}
+
+void testStreaming(const std::filesystem::path& directory) {
+    std::string fileName = (directory / "streaming.ht5").string();
+    {
+        Model::GraphicPrimitivesModel model;
+        ProjectJournal journal;
+        journal.attach(model);
+        edit(model, 2000);
+        journal.save(fileName, 640, 480);
+    }
+    auto snapshot = contents(fileName);
+
+    // Сохранение и закрытие до завершения загрузки не записывают загруженную часть поверх файла
+    {
+        Project::Project project(fileName, true);
+        project.pollLoading();
+        Test::check(project.loadingProgress() < 1 && !project.save(), "streaming: project is saved while loading");
+    }
+    {
+        Project::Project project(fileName, true);
+        project.pollLoading();
+        project.cancelLoading();
+        Test::check(!project.save(), "streaming: cancelled project is saved to its file");
+        Test::check(project.save((directory / "streaming-copy.ht5").string()), "streaming: cancelled project is not saved to a new file");
+    }
+    Test::check(contents(fileName) == snapshot, "streaming: project file is changed by a partially loaded project");
+    Test::check(!std::filesystem::exists(ProjectJournal::journalName(fileName, 0)), "streaming: journal is written for a partially loaded project");
+
+    // После завершения загрузки проект сохраняется в свой файл
+    Project::Project project(fileName, true);
+    while(project.pollLoading(4)) {
+
+    }
+    Test::check(project.save() && contents(fileName) == snapshot, "streaming: loaded project is not saved to its file");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    generator.seed(argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 10)) : 1);
+
+    auto directory = std::filesystem::temp_directory_path() / ("ProjectJournalTest." + std::to_string(generator()));
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    testReplay(directory);
+    testTornTail(directory);
+    testCompaction(directory);
+    testOwnership(directory);
+    testStreaming(directory);
+
+    std::filesystem::remove_all(directory);
+    return Test::result("ProjectJournalTest");
+}
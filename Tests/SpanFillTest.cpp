@@ -0,0 +1,124 @@
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "GUI/SpanFill.h"
+
+/*!
+Сравнение ядер заливки отрезков с попиксельным скалярным определением. Программа собирается в нескольких вариантах:
+без SIMD, с SSE2 и с AVX2, поэтому каждый вариант ядер сверяется с одним и тем же определением. Отрезки начинаются
+и заканчиваются в разных позициях относительно границ векторов, пиксели вокруг отрезка должны остаться прежними.
+Прежние пиксели - случайные цвета, умноженные на альфу, цвета заливки - непрозрачные, полупрозрачные и прозрачные
+*/
+namespace {
+
+using namespace GUI;
+
+constexpr size_t Guard = 16;     ///< пикселей перед и после отрезка, которые не должны измениться
+constexpr size_t MaxOffset = 16; ///< наибольшее смещение начала отрезка
+constexpr size_t MaxCount = 80;  ///< наибольшая длина отрезка
+
+const char* instructionSet() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+/// Ожидаемый результат ядра для одного пикселя
+enum class Operation {
+    Fill,
+    Blend,
+    Composite
+};
+
+uint32_t expectedPixel(Operation operation, uint32_t dst, uint32_t color) {
+    switch(operation) {
+    case Operation::Fill:
+        return color;
+    case Operation::Blend:
+        return Simd::blendPixel(dst, color);
+    default:
+        return (color >> 24) == 255 ? color : (color >> 24) == 0 ? dst : Simd::blendPixel(dst, color);
+    }
+}
+
+/*!
+Заливает отрезок ядром и сравнивает весь буфер с ожидаемым
+\param name имя ядра
+\param kernel ядро, принимает указатель, длину, цвет и маску
+\param operation ожидаемое действие над выбранным пикселем
+\param color цвет заливки
+\param mask маска, 0xFF для ядер без маски
+\param random генератор прежних пикселей
+\return <i>void</i>
+*/
+template<typename Kernel>
+void checkKernel(const char* name, Kernel kernel, Operation operation, uint32_t color, uint8_t mask, std::mt19937& random) {
+    std::vector<uint32_t> buffer(Guard + MaxOffset + MaxCount + Guard);
+    std::vector<uint32_t> expected(buffer.size());
+    for(size_t offset = 0; offset < MaxOffset; offset++) {
+        for(size_t count = 0; count <= MaxCount; count++) {
+            for(auto& pixel : buffer) {
+                pixel = Simd::premultiply(uint32_t(random()));
+            }
+            expected = buffer;
+
+            uint32_t* dst = buffer.data() + Guard + offset;
+            for(size_t i = 0; i < count; i++) {
+                if(mask & (1u << (i & 7))) {
+                    expected[Guard + offset + i] = expectedPixel(operation, expected[Guard + offset + i], color);
+                }
+            }
+            kernel(dst, count, color, mask);
+
+            for(size_t i = 0; i < buffer.size(); i++) {
+                if(!Test::check(buffer[i] == expected[i], "%s %s: color %08x mask %02x offset %zu count %zu pixel %zu: %08x, expected %08x",
+                                instructionSet(), name, color, mask, offset, count, i, buffer[i], expected[i])) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+}
+
+int main() {
+    std::mt19937 random(1);
+    const uint32_t colors[] = {0xFF336699u, 0x80402010u, 0x01010000u, 0xFEFDFCFBu, 0x00000000u};
+    const uint8_t masks[] = {0x01, 0x11, 0x55, 0x0F, 0xF0, 0x7E, 0xFE, 0xFF, 0x00, 0x81};
+
+    for(uint32_t color : colors) {
+        uint32_t opaque = color | 0xFF000000u;
+        checkKernel("fillSpan", [](uint32_t* dst, size_t count, uint32_t value, uint8_t) {
+            Simd::fillSpan(dst, count, value);
+        }, Operation::Fill, opaque, 0xFF, random);
+        checkKernel("blendSpan", [](uint32_t* dst, size_t count, uint32_t value, uint8_t) {
+            Simd::blendSpan(dst, count, value);
+        }, Operation::Blend, color, 0xFF, random);
+        checkKernel("compositeSpan", [](uint32_t* dst, size_t count, uint32_t value, uint8_t) {
+            Simd::compositeSpan(dst, count, value);
+        }, Operation::Composite, color, 0xFF, random);
+
+        for(uint8_t mask : masks) {
+            checkKernel("fillSpanStrided", Simd::fillSpanStrided, Operation::Fill, opaque, mask, random);
+            checkKernel("fillSpanMasked", Simd::fillSpanMasked, Operation::Fill, opaque, mask, random);
+            checkKernel("blendSpanMasked", Simd::blendSpanMasked, Operation::Blend, color, mask, random);
+            checkKernel("compositeSpanMasked", Simd::compositeSpanMasked, Operation::Composite, color, mask, random);
+        }
+    }
+
+    for(uint32_t color = 0; color < 256; color++) {
+        uint32_t premultiplied = Simd::premultiply((color << 24) | (uint32_t(random()) & 0xFFFFFFu));
+        checkKernel("blendSpan", [](uint32_t* dst, size_t count, uint32_t value, uint8_t) {
+            Simd::blendSpan(dst, count, value);
+        }, Operation::Blend, premultiplied, 0xFF, random);
+    }
+
+    std::printf("instruction set: %s\n", instructionSet());
+    return Test::result("SpanFillTest");
+}
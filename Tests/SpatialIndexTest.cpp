@@ -0,0 +1,175 @@
+#include <map>
+#include <random>
+#include <vector>
+#include <cmath>
+
+#include "Test.h"
+#include "GUI/SpatialIndex.h"
+
+/*!
+Сравнение пространственного индекса с линейным просмотром всех фигур. Случайно добавляются и удаляются фигуры
+всех размеров: точечные, обычные, крупные (хранятся отдельным списком), с отрицательными координатами и пустые.
+Периодически проверяются <i>query</i> на малых областях и на областях больше всех ячеек индекса (полный просмотр ячеек),
+<i>queryLarge</i>, <i>findTopmost</i> с предикатом и грубые представления ячеек нескольких уровней пирамиды.
+Аргументы: количество операций (по умолчанию 20000), начальное значение генератора (по умолчанию 1)
+*/
+namespace {
+
+using namespace GUI;
+
+constexpr double CellSize = 64;
+constexpr double World = 2000; ///< координаты фигур лежат в [-World, World]
+
+std::mt19937 generator;
+
+double uniform(double from, double to) {
+    return std::uniform_real_distribution<double>(from, to)(generator);
+}
+
+Area randomFigureArea() {
+    double kind = uniform(0, 1);
+    double size = kind < 0.05 ? 0 : kind < 0.3 ? uniform(0.01, 4) : kind < 0.9 ? uniform(4, 200) : uniform(600, 1500);
+    return {{uniform(-World, World), uniform(-World, World)}, size * uniform(0.2, 1.5), size * uniform(0.2, 1.5)};
+}
+
+Area randomQueryArea() {
+    double kind = uniform(0, 1);
+    double size = kind < 0.3 ? uniform(0.01, 10) : kind < 0.8 ? uniform(10, 500) : uniform(3000, 6000);
+    return {{uniform(-World - 500, World), uniform(-World - 500, World)}, size * uniform(0.5, 1.5), size * uniform(0.5, 1.5)};
+}
+
+uint32_t colorOf(size_t id) {
+    return uint32_t(id) + 1;
+}
+
+/*!
+Возвращает диапазон номеров ячеек, которые задевает отрезок [from, to) при размере ячейки size, так же, как индекс
+\param from начало отрезка
+\param to конец отрезка
+\param size размер ячейки
+\return <i>std::pair<int64_t, int64_t></i>
+*/
+std::pair<int64_t, int64_t> cellRange(double from, double to, double size) {
+    return {int64_t(std::floor(from / size)), int64_t(std::floor(std::nextafter(to, from) / size))};
+}
+
+/*!
+Сверяет грубые представления уровня пирамиды с верхней некрупной фигурой каждой ячейки
+\param index индекс
+\param figures фигуры индекса
+\param level уровень пирамиды
+\param area область запроса
+\return <i>void</i>
+*/
+void checkAggregates(const SpatialIndex& index, const std::map<size_t, Area>& figures, size_t level, const Area& area) {
+    double size = std::ldexp(CellSize, int(level));
+    std::map<std::pair<int64_t, int64_t>, size_t> expected;
+    auto columns = cellRange(area.corner.x, area.right(), size);
+    auto rows = cellRange(area.corner.y, area.bottom(), size);
+    for(const auto& [id, bounds] : figures) {
+        if(index.isLarge(bounds)) {
+            continue;
+        }
+
+        auto figureColumns = cellRange(bounds.corner.x, bounds.right(), CellSize);
+        auto figureRows = cellRange(bounds.corner.y, bounds.bottom(), CellSize);
+        for(int64_t y = figureRows.first >> level; y <= figureRows.second >> level; y++) {
+            for(int64_t x = figureColumns.first >> level; x <= figureColumns.second >> level; x++) {
+                if(x >= columns.first && x <= columns.second && y >= rows.first && y <= rows.second) {
+                    auto& top = expected[{x, y}];
+                    top = std::max(top, id + 1);
+                }
+            }
+        }
+    }
+
+    size_t reported = 0;
+    index.forEachAggregate(area, size, [&](const Area& cell, uint32_t color) {
+        reported++;
+        auto key = std::make_pair(int64_t(std::lround(cell.corner.x / size)), int64_t(std::lround(cell.corner.y / size)));
+        auto expectedItr = expected.find(key);
+        Test::check(expectedItr != expected.end() && colorOf(expectedItr->second - 1) == color,
+                    "aggregate level %zu cell (%lld, %lld): color %u, expected %u", level, (long long)key.first, (long long)key.second,
+                    color, expectedItr == expected.end() ? 0 : colorOf(expectedItr->second - 1));
+    });
+    Test::check(reported == expected.size(), "aggregate level %zu: %zu cells reported, expected %zu", level, reported, expected.size());
+}
+
+/*!
+Сверяет запросы индекса с линейным просмотром
+\param index индекс
+\param figures фигуры индекса
+\return <i>void</i>
+*/
+void checkQueries(SpatialIndex& index, const std::map<size_t, Area>& figures) {
+    Test::check(index.count() == figures.size(), "count %zu, expected %zu", index.count(), figures.size());
+    for(int i = 0; i < 20; i++) {
+        Area area = randomQueryArea();
+        std::vector<size_t> expected;
+        std::vector<size_t> expectedLarge;
+        for(const auto& [id, bounds] : figures) {
+            if(bounds.intersects(area)) {
+                expected.push_back(id);
+                if(index.isLarge(bounds)) {
+                    expectedLarge.push_back(id);
+                }
+            }
+        }
+
+        Test::check(index.query(area) == expected, "query (%g, %g, %g x %g): %zu ids, expected %zu",
+                    area.corner.x, area.corner.y, area.width, area.height, index.query(area).size(), expected.size());
+        Test::check(index.queryLarge(area) == expectedLarge, "queryLarge (%g, %g, %g x %g)", area.corner.x, area.corner.y, area.width, area.height);
+
+        auto accepted = [](size_t id) { return id % 3 != 0; };
+        size_t topmost = SpatialIndex::NotFound;
+        for(auto id : expected) {
+            if(accepted(id)) {
+                topmost = id;
+            }
+        }
+        size_t found = index.findTopmost(area, accepted);
+        Test::check(found == topmost, "findTopmost (%g, %g, %g x %g): %zu, expected %zu",
+                    area.corner.x, area.corner.y, area.width, area.height, found, topmost);
+    }
+
+    index.refreshAggregates();
+    for(size_t level : {0, 1, 3}) {
+        checkAggregates(index, figures, level, randomQueryArea());
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 20000;
+    generator.seed(argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1);
+
+    SpatialIndex index(CellSize);
+    std::map<size_t, Area> figures;
+    size_t nextId = 0;
+    for(size_t operation = 0; operation < operations; operation++) {
+        if(figures.empty() || uniform(0, 1) < 0.6) {
+            Area area = randomFigureArea();
+            size_t id = nextId++;
+            index.insert(id, area, colorOf(id));
+            if(!area.isEmpty()) {
+                figures[id] = area;
+            }
+            Test::check(index.bounds(id).width == (area.isEmpty() ? 0 : area.width), "bounds of %zu", id);
+        }
+        else {
+            auto figureItr = std::next(figures.begin(), std::uniform_int_distribution<size_t>(0, figures.size() - 1)(generator));
+            index.remove(figureItr->first);
+            figures.erase(figureItr);
+        }
+
+        if(operation % 500 == 499) {
+            checkQueries(index, figures);
+        }
+    }
+
+    index.clear();
+    figures.clear();
+    checkQueries(index, figures);
+    return Test::result("SpatialIndexTest");
+}
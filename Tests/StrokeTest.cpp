@@ -0,0 +1,179 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "GUI/Painter.h"
+
+/*!
+Проверка отрезков, концы которых лежат далеко за холстом, при большом увеличении. Отрезки проходят через холст,
+а их концы на холсте удалены на расстояния от тысяч до 10^15 пикселей, шире диапазона 32-битных целых. Отрезок, нарисованный
+целиком, должен совпасть с нарисованным по плиткам. Для отрезков длиной до 10^12 пикселей дополнительно проверяется
+геометрия: закрашенные пиксели лежат у отрезка, тонкий сплошной отрезок не прерывается на холсте, а внутренняя часть
+толстого закрашена. Пунктир и точки закрашивают часть пикселей сплошного отрезка той же толщины.
+Аргументы: количество отрезков на сочетание масштаба, толщины и кисти (по умолчанию 40), начальное значение генератора (по умолчанию 1)
+*/
+namespace {
+
+using namespace GraphicPrimitive;
+
+constexpr uint32_t Width = 320;
+constexpr uint32_t Height = 200;
+constexpr double TileSize = 64;
+constexpr uint32_t PenColor = 0xFF336699u;
+
+std::mt19937 generator;
+
+double uniform(double from, double to) {
+    return std::uniform_real_distribution<double>(from, to)(generator);
+}
+
+/// Отрезок в координатах сцены и преобразование, при котором его концы уходят далеко за холст
+struct Case {
+    Point p1 = {0, 0};
+    Point p2 = {0, 0};
+    GUI::Transform transform;
+    double length = 0; ///< наибольшее удаление конца от холста в пикселях
+};
+
+Case randomCase(double scale) {
+    Case result;
+    result.transform.scale = scale;
+    result.transform.origin = {uniform(-1000, 1000), uniform(-1000, 1000)};
+    result.length = std::pow(10.0, uniform(3, 15));
+
+    double angle = uniform(0, 2 * M_PI);
+    Point center = {uniform(20, Width - 20), uniform(20, Height - 20)};
+    Point direction = {std::cos(angle), std::sin(angle)};
+    double forward = result.length * uniform(0.5, 1);
+    double backward = result.length * uniform(0.5, 1);
+    result.p1 = result.transform.unmap({center.x - direction.x * backward, center.y - direction.y * backward});
+    result.p2 = result.transform.unmap({center.x + direction.x * forward, center.y + direction.y * forward});
+    return result;
+}
+
+std::vector<uint32_t> render(const Case& stroke, float penWidth, PenType penType, bool tiled) {
+    auto canvas = std::make_shared<GUI::Canvas>(Width, Height);
+    GUI::Painter painter;
+    painter.setCanvas(canvas);
+    painter.clearAll();
+    painter.setTransform(stroke.transform);
+
+    FigureValue line = Line(stroke.p1, stroke.p2, PenColor, penType, float(penWidth / stroke.transform.scale));
+    if(!tiled) {
+        painter.drawFigure(line);
+    }
+    else {
+        for(double y = 0; y < Height; y += TileSize) {
+            for(double x = 0; x < Width; x += TileSize) {
+                painter.setClip({{x, y}, TileSize, TileSize});
+                painter.drawFigure(line);
+            }
+        }
+    }
+
+    std::vector<uint32_t> pixels;
+    for(uint32_t y = 0; y < Height; y++) {
+        for(uint32_t x = 0; x < Width; x++) {
+            pixels.push_back(canvas->pixel(x, y));
+        }
+    }
+    return pixels;
+}
+
+/*!
+Возвращает расстояние от центра пикселя до прямой отрезка на холсте
+\param stroke отрезок
+\param x координата x пикселя
+\param y координата y пикселя
+\return <i>double</i>
+*/
+double distance(const Case& stroke, uint32_t x, uint32_t y) {
+    Point a = stroke.transform.map(stroke.p1);
+    Point b = stroke.transform.map(stroke.p2);
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    return std::abs((x + 0.5 - a.x) * dy - (y + 0.5 - a.y) * dx) / std::hypot(dx, dy);
+}
+
+/*!
+Проверяет геометрию сплошного отрезка: закрашенные пиксели лежат не дальше допуска от прямой, а пиксели у прямой закрашены
+\param stroke отрезок
+\param penWidth толщина кисти на холсте
+\param pixels изображение отрезка
+\return <i>void</i>
+*/
+void checkGeometry(const Case& stroke, float penWidth, const std::vector<uint32_t>& pixels) {
+    double tolerance = penWidth / 2 + 1.5;
+    Point a = stroke.transform.map(stroke.p1);
+    Point b = stroke.transform.map(stroke.p2);
+    bool horizontal = std::abs(b.x - a.x) >= std::abs(b.y - a.y);
+    std::vector<bool> covered(horizontal ? Width : Height);
+
+    for(uint32_t y = 0; y < Height; y++) {
+        for(uint32_t x = 0; x < Width; x++) {
+            double away = distance(stroke, x, y);
+            bool painted = pixels[y * Width + x] != 0;
+            Test::check(!painted || away <= tolerance, "pen %g, length %g: pixel (%u, %u) is %g px away from the line",
+                        double(penWidth), stroke.length, x, y, away);
+            Test::check(painted || away > penWidth / 2 - 1.5, "pen %g, length %g: pixel (%u, %u) inside the pen is not painted",
+                        double(penWidth), stroke.length, x, y);
+            if(painted) {
+                covered[horizontal ? x : y] = true;
+            }
+        }
+    }
+
+    // Тонкий отрезок закрашивает хотя бы один пиксель в каждом столбце длинной оси, где он проходит внутри холста
+    double slope = horizontal ? (b.y - a.y) / (b.x - a.x) : (b.x - a.x) / (b.y - a.y);
+    double minorSize = horizontal ? Height : Width;
+    for(size_t major = 0; major < covered.size(); major++) {
+        double minor = horizontal ? a.y + (major + 0.5 - a.x) * slope : a.x + (major + 0.5 - a.y) * slope;
+        Test::check(covered[major] || minor < 2 || minor > minorSize - 2, "pen %g, length %g: line has a gap at %zu",
+                    double(penWidth), stroke.length, major);
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 40;
+    generator.seed(argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1);
+
+    for(double scale : {1.0, 1e3, 1e6, 1e9}) {
+        for(float penWidth : {0.9f, 3.0f}) {
+            for(size_t i = 0; i < count; i++) {
+                Case stroke = randomCase(scale);
+                std::vector<uint32_t> solid = render(stroke, penWidth, PenType::Solid, false);
+                Test::check(solid == render(stroke, penWidth, PenType::Solid, true), "scale %g, pen %g, length %g: tiled line differs",
+                            scale, double(penWidth), stroke.length);
+                if(stroke.length <= 1e12) {
+                    checkGeometry(stroke, penWidth, solid);
+                }
+
+                size_t solidCount = 0;
+                for(uint32_t pixel : solid) {
+                    solidCount += pixel != 0;
+                }
+                for(PenType penType : {PenType::Dash, PenType::Dot}) {
+                    std::vector<uint32_t> dashed = render(stroke, penWidth, penType, false);
+                    Test::check(dashed == render(stroke, penWidth, penType, true), "scale %g, pen %g, length %g: tiled dashes differ",
+                                scale, double(penWidth), stroke.length);
+
+                    size_t dashedCount = 0;
+                    bool subset = true;
+                    for(size_t pixel = 0; pixel < dashed.size(); pixel++) {
+                        dashedCount += dashed[pixel] != 0;
+                        subset = subset && (dashed[pixel] == 0 || solid[pixel] != 0);
+                    }
+                    Test::check(subset, "scale %g, pen %g, length %g: dashes leave the solid line", scale, double(penWidth), stroke.length);
+                    Test::check(solidCount < 200 || (dashedCount > solidCount / 8 && dashedCount < solidCount * 9 / 10),
+                                "scale %g, pen %g, length %g: %zu of %zu pixels are dashed", scale, double(penWidth), stroke.length,
+                                dashedCount, solidCount);
+                }
+            }
+        }
+    }
+
+    return Test::result("StrokeTest");
+}
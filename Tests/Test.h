@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+
+/*!
+\brief Общие средства тестов
+
+Тест - отдельная программа без сторонних библиотек: проверки печатают описание нарушения и продолжают работу,
+код возврата программы ненулевой, если хотя бы одна проверка не прошла
+*/
+namespace Test {
+
+/*!
+Возвращает счетчик непрошедших проверок
+\return <i>size_t&</i>
+*/
+inline size_t& failures() {
+    static size_t count = 0;
+    return count;
+}
+
+/*!
+Проверяет условие, при нарушении печатает сообщение в формате printf и увеличивает счетчик непрошедших проверок.
+Печатаются только первые 20 нарушений
+\param condition проверяемое условие
+\param format формат сообщения
+\return <i>bool</i> значение условия
+*/
+inline bool check(bool condition, const char* format, ...) {
+    if(condition) {
+        return true;
+    }
+
+    if(failures()++ < 20) {
+        std::va_list arguments;
+        va_start(arguments, format);
+        std::vprintf(format, arguments);
+        va_end(arguments);
+        std::printf("\n");
+    }
+    return false;
+}
+
+/*!
+Печатает итог и возвращает код возврата программы
+\param name имя теста
+\return <i>int</i>
+*/
+inline int result(const char* name) {
+    std::printf("%s: %s, failures %zu\n", name, failures() == 0 ? "passed" : "FAILED", failures());
+    return failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}